@@ -0,0 +1,62 @@
+// Request admission for the web server: a fixed pool of preallocated response buffers, one per response in flight.
+// Lower priority routes leave some buffers free for higher priority ones, and are turned away when they cannot,
+// so memory use stays flat however many clients are refreshing pages.
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+enum RoutePriority : uint8_t {
+  PRIORITY_CONTROL    = 0,  // Settings handlers and the JSON API, may use every buffer
+  PRIORITY_STATUS     = 1,  // Status and settings pages
+  PRIORITY_DECORATIVE = 2   // Graphs, statistics, help and the like, shed first under load
+};
+
+template <size_t SLOTS, size_t BUFFER_SIZE>
+class ResponsePool {
+  static_assert(SLOTS <= 32, "slot usage is held in a 32-bit mask");
+
+public:
+  static const size_t SIZE = BUFFER_SIZE;
+
+  // Returns a buffer slot, or -1 when admitting the priority would eat into the reserve of higher ones
+  int acquire(uint8_t priority) {
+    uint32_t used = _used.load(std::memory_order_relaxed);
+    for (;;) {
+      size_t free = SLOTS - countBits(used);
+      if (free == 0 || free <= (size_t)priority) {
+        _rejected.fetch_add(1, std::memory_order_relaxed);
+        return -1;
+      }
+      int slot = 0;
+      while (used & (1u << slot)) slot++;
+      if (_used.compare_exchange_weak(used, used | (1u << slot), std::memory_order_acquire)) {
+        _admitted.fetch_add(1, std::memory_order_relaxed);
+        return slot;
+      }
+    }
+  }
+
+  void release(int slot) {
+    if (slot >= 0 && slot < (int)SLOTS) _used.fetch_and(~(1u << slot), std::memory_order_release);
+  }
+
+  char *buffer(int slot) { return _buffers[slot]; }
+
+  size_t inFlight() const { return countBits(_used.load(std::memory_order_relaxed)); }
+  uint32_t admitted() const { return _admitted.load(std::memory_order_relaxed); }
+  uint32_t rejected() const { return _rejected.load(std::memory_order_relaxed); }
+
+private:
+  static size_t countBits(uint32_t v) {
+    size_t n = 0;
+    for (; v; v &= v - 1) n++;
+    return n;
+  }
+
+  char _buffers[SLOTS][BUFFER_SIZE];
+  std::atomic<uint32_t> _used{0};
+  std::atomic<uint32_t> _admitted{0};
+  std::atomic<uint32_t> _rejected{0};
+};
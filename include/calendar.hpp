@@ -0,0 +1,96 @@
+// Date-range exceptions layered over the weekly schedule, e.g. away weeks, holidays and one-off set-points.
+// Entries are held sorted by start time and are not allowed to overlap, so the entry covering any given
+// moment is found with a single binary search and no allocation.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum ExceptionKind : uint8_t {
+  EXCEPTION_AWAY     = 0,   // Schedule suspended, only frost protection remains active
+  EXCEPTION_HOLIDAY  = 1,   // Follow another day's schedule, Value holds the day of week (0 = Sun)
+  EXCEPTION_SETPOINT = 2    // Hold a fixed set-point, Value holds the temperature
+};
+
+struct CalendarException {
+  uint32_t Start = 0;       // Unix time the exception begins (inclusive)
+  uint32_t Stop  = 0;       // Unix time the exception ends (exclusive)
+  uint8_t  Kind  = EXCEPTION_AWAY;
+  float    Value = 0;
+};
+
+template <size_t N>
+class ExceptionCalendar {
+public:
+  size_t size() const { return _count; }
+  bool full() const { return _count >= N; }
+  const CalendarException &at(size_t i) const { return _entries[i]; }
+  const CalendarException *data() const { return _entries; }
+
+  void clear() { _count = 0; }
+
+  // Returns the exception covering time t, or nullptr when the weekly schedule applies
+  const CalendarException *find(uint32_t t) const {
+    size_t i = upperBound(t);                 // First entry starting after t
+    if (i == 0) return nullptr;
+    const CalendarException &e = _entries[i - 1];
+    return (t < e.Stop) ? &e : nullptr;       // Entries never overlap, so only the predecessor can cover t
+  }
+
+  // Inserts in start order, rejects invalid or overlapping ranges and a full table
+  bool add(const CalendarException &e) {
+    if (!valid(e) || full()) return false;
+    size_t i = upperBound(e.Start);
+    if (i > 0 && _entries[i - 1].Stop > e.Start) return false;
+    if (i < _count && _entries[i].Start < e.Stop) return false;
+    for (size_t j = _count; j > i; j--) _entries[j] = _entries[j - 1];
+    _entries[i] = e;
+    _count++;
+    return true;
+  }
+
+  bool remove(size_t i) {
+    if (i >= _count) return false;
+    for (size_t j = i + 1; j < _count; j++) _entries[j - 1] = _entries[j];
+    _count--;
+    return true;
+  }
+
+  // Drops entries that finished before time t, returns the number removed
+  size_t prune(uint32_t t) {
+    size_t expired = 0;
+    while (expired < _count && _entries[expired].Stop <= t) expired++;
+    for (size_t j = expired; j < _count; j++) _entries[j - expired] = _entries[j];
+    _count -= expired;
+    return expired;
+  }
+
+  // Replaces the table from persisted entries, stops at the first entry that breaks the ordering
+  size_t load(const CalendarException *entries, size_t count) {
+    clear();
+    for (size_t i = 0; i < count && !full(); i++) {
+      if (!valid(entries[i]) || (_count > 0 && entries[i].Start < _entries[_count - 1].Stop)) break;
+      _entries[_count++] = entries[i];
+    }
+    return _count;
+  }
+
+private:
+  static bool valid(const CalendarException &e) {
+    if (e.Stop <= e.Start) return false;
+    if (e.Kind == EXCEPTION_HOLIDAY) return e.Value >= 0 && e.Value <= 6;
+    return e.Kind == EXCEPTION_AWAY || e.Kind == EXCEPTION_SETPOINT;
+  }
+
+  size_t upperBound(uint32_t t) const {
+    size_t lo = 0, hi = _count;
+    while (lo < hi) {
+      size_t mid = lo + (hi - lo) / 2;
+      if (_entries[mid].Start <= t) lo = mid + 1; else hi = mid;
+    }
+    return lo;
+  }
+
+  CalendarException _entries[N];
+  size_t _count = 0;
+};
@@ -0,0 +1,114 @@
+// Warm restart checkpoint of the controller state and recent history, meant to live in memory that survives a
+// reset but not a power cycle (RTC slow memory on the ESP32). It is updated in place as things change: the header
+// and the history carry separate CRCs, so a control tick only re-checks the few header bytes.
+// Must stay trivially constructible, a constructor would wipe the checkpoint at every boot.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+
+const uint32_t CHECKPOINT_MAGIC   = 0x54504B43;  // 'CKPT'
+const uint16_t CHECKPOINT_VERSION = 1;
+
+inline uint32_t checkpointCrc(const void *data, size_t len) {
+  const uint8_t *p = (const uint8_t *)data;
+  uint32_t crc = 0xFFFFFFFF;
+  while (len--) {
+    crc ^= *p++;
+    for (int b = 0; b < 8; b++) crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+  }
+  return ~crc;
+}
+
+struct CheckpointSample {
+  int16_t Temp;                 // Temperature x 100
+  uint8_t Humi;
+  uint8_t Heat;
+};
+
+template <size_t HISTORY>
+struct Checkpoint {
+  uint32_t Magic;
+  uint16_t Version;
+  uint16_t Size;                // Layout check, changes whenever HISTORY or the fields do
+  uint32_t Epoch;               // Last valid Unix time
+  uint32_t WarmStarts;          // Number of times the checkpoint has been restored
+  float    LastTemperature;     // Rogue reading filter state
+  float    TargetTemp;
+  float    ManOverrideTemp;
+  uint8_t  RelayOn;
+  uint8_t  ManualOverride;
+  uint8_t  TimerOn;
+  uint8_t  Reserved;
+  uint16_t HistoryHead;         // Next slot to write
+  uint16_t HistoryCount;
+  uint32_t HeaderCrc;           // Covers everything above
+  uint32_t HistoryCrc;          // Covers History
+  CheckpointSample History[HISTORY];
+
+  void reset() {
+    Magic = CHECKPOINT_MAGIC;
+    Version = CHECKPOINT_VERSION;
+    Size = sizeof(*this);
+    Epoch = WarmStarts = 0;
+    LastTemperature = TargetTemp = ManOverrideTemp = 0;
+    RelayOn = ManualOverride = TimerOn = Reserved = 0;
+    HistoryHead = HistoryCount = 0;
+    HistoryCrc = checkpointCrc(History, sizeof(History));
+    seal();
+  }
+
+  bool valid() const {
+    return Magic == CHECKPOINT_MAGIC && Version == CHECKPOINT_VERSION && Size == sizeof(*this) &&
+           HistoryHead < HISTORY && HistoryCount <= HISTORY &&
+           HeaderCrc == headerCrc() && HistoryCrc == checkpointCrc(History, sizeof(History));
+  }
+
+  // Call after changing any header field
+  void seal() { HeaderCrc = headerCrc(); }
+
+  void addSample(float temp, uint8_t humi, uint8_t heat) {
+    CheckpointSample &s = History[HistoryHead];
+    s.Temp = (int16_t)(temp * 100 + (temp < 0 ? -0.5f : 0.5f));
+    s.Humi = humi;
+    s.Heat = heat;
+    HistoryHead = (HistoryHead + 1) % HISTORY;
+    if (HistoryCount < HISTORY) HistoryCount++;
+    HistoryCrc = checkpointCrc(History, sizeof(History));
+    seal();
+  }
+
+  // Oldest first
+  const CheckpointSample &sample(size_t i) const { return History[(HistoryHead + HISTORY - HistoryCount + i) % HISTORY]; }
+
+private:
+  uint32_t headerCrc() const { return checkpointCrc(this, (const uint8_t *)&HeaderCrc - (const uint8_t *)this); }
+};
+
+// Byte copy of a trivially copyable object kept beside the checkpoint, e.g. statistics or relay accounting, with its own
+// size and CRC so that garbage after a power cycle or a changed layout is never restored. Trivially constructible too.
+template <class T>
+struct CheckpointImage {
+  static_assert(std::is_trivially_copyable<T>::value, "Only plain data can be copied byte for byte");
+
+  uint32_t Size;
+  uint32_t Crc;
+  uint8_t  Bytes[sizeof(T)];
+
+  void clear() { Size = 0; }
+
+  void save(const T &object) {
+    memcpy(Bytes, &object, sizeof(T));
+    Size = sizeof(T);
+    Crc = checkpointCrc(Bytes, sizeof(Bytes));
+  }
+
+  // Leaves the object untouched when the image is not valid
+  bool restore(T &object) const {
+    if (Size != sizeof(T) || Crc != checkpointCrc(Bytes, sizeof(Bytes))) return false;
+    memcpy(&object, Bytes, sizeof(T));
+    return true;
+  }
+};
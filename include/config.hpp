@@ -37,3 +37,11 @@
 // Australia                "ACST-9:30ACDT,M10.1.0,M4.1.0/3":
 #define THERMOSTAT_TIMEZONE "MET-1METDST,M3.5.0/01,M10.5.0/02"
 #endif
+
+#ifndef THERMOSTAT_HEATER_POWER
+#define THERMOSTAT_HEATER_POWER 2000 // Heater power in Watts, only used to estimate energy use
+#endif
+
+#ifndef THERMOSTAT_SENSOR_PORT
+#define THERMOSTAT_SENSOR_PORT 4210 // UDP port for remote sensor nodes, which are only accepted when THERMOSTAT_SENSOR_KEY is set
+#endif
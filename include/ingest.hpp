@@ -0,0 +1,295 @@
+// Ingestion of batched readings from remote battery sensor nodes over UDP.
+// Packets are authenticated with SipHash-2-4 under a shared key, then deduplicated and put back into sequence
+// order per node before the readings are handed on, one batch per packet. Portable, so the same code runs
+// on the ESP32 and in the native test build.
+//
+// A node numbers its packets with (boot, sequence), where boot is a counter it keeps in flash and increments
+// at every start. Both are signed, so a captured packet can never again sort after the ones already taken:
+// only a higher boot number restarts the sequence. The first packet after the thermostat itself starts is taken
+// on trust, there is nothing yet to compare it with.
+//
+// Packet layout, little-endian:
+//   uint16 magic 'TS', uint8 version, uint8 node id, uint32 boot, uint32 sequence, uint8 count,
+//   count x { int16 temperature x 100, uint8 humidity %, uint8 battery % },
+//   uint64 SipHash-2-4 tag of all the preceding bytes
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+const uint16_t SENSOR_PACKET_MAGIC   = 0x5354;
+const uint8_t  SENSOR_PACKET_VERSION = 2;
+const size_t   SENSOR_PACKET_HEADER  = 13;
+const size_t   SENSOR_PACKET_READING = 4;
+const size_t   SENSOR_PACKET_TAG     = 8;
+const size_t   SENSOR_PACKET_BATCH   = 16;     // Most readings in one packet
+const size_t   SENSOR_PACKET_MAX     = SENSOR_PACKET_HEADER + SENSOR_PACKET_BATCH * SENSOR_PACKET_READING + SENSOR_PACKET_TAG;
+
+struct SensorReading {
+  float   Temp    = 0;
+  uint8_t Humi    = 0;
+  uint8_t Battery = 0;
+};
+
+struct SensorNodeStats {
+  uint8_t  Node       = 0;
+  uint32_t LastSeenMs = 0;
+  uint32_t Packets    = 0;   // Accepted packets, including ones still waiting for a gap to fill
+  uint32_t Readings   = 0;   // Readings handed on
+  uint32_t Duplicates = 0;   // Retransmissions and replays of packets already taken
+  uint32_t Reordered  = 0;   // Packets that arrived after a later one, filling a gap
+  uint32_t Lost       = 0;   // Sequence numbers given up on
+  uint32_t Restarts   = 0;   // New boot numbers, i.e. node resets
+  SensorReading Last;
+};
+
+enum IngestResult : uint8_t {
+  INGEST_ACCEPTED,
+  INGEST_DUPLICATE,
+  INGEST_MALFORMED,
+  INGEST_UNAUTHENTICATED,
+  INGEST_NO_ROOM             // Node table full
+};
+
+inline uint64_t sipRotate(uint64_t x, int b) { return (x << b) | (x >> (64 - b)); }
+
+inline uint64_t sipLoad64(const uint8_t *p) {
+  uint64_t v = 0;
+  for (int i = 7; i >= 0; i--) v = (v << 8) | p[i];
+  return v;
+}
+
+inline uint32_t sipLoad32(const uint8_t *p) { return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24; }
+
+inline uint64_t sipHash24(const uint8_t key[16], const uint8_t *data, size_t len) {
+  uint64_t k0 = sipLoad64(key), k1 = sipLoad64(key + 8);
+  uint64_t v0 = 0x736f6d6570736575ULL ^ k0, v1 = 0x646f72616e646f6dULL ^ k1;
+  uint64_t v2 = 0x6c7967656e657261ULL ^ k0, v3 = 0x7465646279746573ULL ^ k1;
+  uint64_t b = (uint64_t)len << 56;
+#define SIP_ROUND do { \
+    v0 += v1; v1 = sipRotate(v1, 13); v1 ^= v0; v0 = sipRotate(v0, 32); \
+    v2 += v3; v3 = sipRotate(v3, 16); v3 ^= v2; \
+    v0 += v3; v3 = sipRotate(v3, 21); v3 ^= v0; \
+    v2 += v1; v1 = sipRotate(v1, 17); v1 ^= v2; v2 = sipRotate(v2, 32); } while (0)
+  size_t full = len & ~(size_t)7;
+  for (size_t i = 0; i < full; i += 8) {
+    uint64_t m = sipLoad64(data + i);
+    v3 ^= m; SIP_ROUND; SIP_ROUND; v0 ^= m;
+  }
+  for (size_t i = 0; i < (len & 7); i++) b |= (uint64_t)data[full + i] << (8 * i);
+  v3 ^= b; SIP_ROUND; SIP_ROUND; v0 ^= b;
+  v2 ^= 0xff;
+  SIP_ROUND; SIP_ROUND; SIP_ROUND; SIP_ROUND;
+#undef SIP_ROUND
+  return v0 ^ v1 ^ v2 ^ v3;
+}
+
+// Parses a 32 hex digit key, returns false if malformed
+inline bool parseSensorKey(const char *hex, uint8_t key[16]) {
+  if (!hex || strlen(hex) != 32) return false;
+  for (int i = 0; i < 32; i++) {
+    char c = hex[i];
+    int v = (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+    if (v < 0) return false;
+    if (i % 2 == 0) key[i / 2] = v << 4; else key[i / 2] |= v;
+  }
+  return true;
+}
+
+// Builds a signed packet, returns its length or 0 when count is out of range
+inline size_t encodeSensorPacket(const uint8_t key[16], uint8_t node, uint32_t boot, uint32_t seq, const SensorReading *readings, size_t count, uint8_t *out) {
+  if (count == 0 || count > SENSOR_PACKET_BATCH) return 0;
+  uint8_t *p = out;
+  *p++ = SENSOR_PACKET_MAGIC & 0xff; *p++ = SENSOR_PACKET_MAGIC >> 8;
+  *p++ = SENSOR_PACKET_VERSION;
+  *p++ = node;
+  for (int i = 0; i < 4; i++) *p++ = boot >> (8 * i);
+  for (int i = 0; i < 4; i++) *p++ = seq >> (8 * i);
+  *p++ = count;
+  for (size_t r = 0; r < count; r++) {
+    int16_t t = (int16_t)(readings[r].Temp * 100 + (readings[r].Temp < 0 ? -0.5f : 0.5f));
+    *p++ = (uint16_t)t & 0xff; *p++ = (uint16_t)t >> 8;
+    *p++ = readings[r].Humi;
+    *p++ = readings[r].Battery;
+  }
+  uint64_t tag = sipHash24(key, out, p - out);
+  for (int i = 0; i < 8; i++) *p++ = tag >> (8 * i);
+  return p - out;
+}
+
+// MAX_NODES remote nodes are tracked, each holding up to WINDOW packets that arrived ahead of a missing one
+template <size_t MAX_NODES, size_t WINDOW>
+class SensorIngest {
+public:
+  // slot is the node's position in the table, stable for as long as the node is known
+  typedef void (*Deliver)(size_t slot, const SensorNodeStats &node, const SensorReading *readings, size_t count);
+
+  void begin(const uint8_t key[16], Deliver deliver, uint32_t reorderTimeoutMs) {
+    memcpy(_key, key, sizeof(_key));
+    _deliver = deliver;
+    _timeoutMs = reorderTimeoutMs;
+  }
+
+  IngestResult receive(const uint8_t *data, size_t len, uint32_t nowMs) {
+    if (len < SENSOR_PACKET_HEADER + SENSOR_PACKET_TAG || len > SENSOR_PACKET_MAX) return reject(INGEST_MALFORMED);
+    uint8_t count = data[12];
+    if ((data[0] | data[1] << 8) != SENSOR_PACKET_MAGIC || data[2] != SENSOR_PACKET_VERSION || count == 0 || count > SENSOR_PACKET_BATCH ||
+        len != SENSOR_PACKET_HEADER + count * SENSOR_PACKET_READING + SENSOR_PACKET_TAG) return reject(INGEST_MALFORMED);
+    if (sipHash24(_key, data, len - SENSOR_PACKET_TAG) != sipLoad64(data + len - SENSOR_PACKET_TAG)) return reject(INGEST_UNAUTHENTICATED);
+    uint32_t boot = sipLoad32(data + 4), seq = sipLoad32(data + 8);
+    int slot = findNode(data[3]);
+    if (slot < 0) return reject(INGEST_NO_ROOM);
+    Node &n = _nodes[slot];
+    if (!n.Started) {                         // First contact, nothing to compare with yet
+      n.Started = true;
+      n.Boot = boot;
+      n.Next = n.Highest = seq;
+    }
+    else if (boot > n.Boot) {                 // The node has reset and started counting again
+      restart(slot, boot, seq);
+    }
+    int32_t ahead = (int32_t)(seq - n.Next);
+    if (boot < n.Boot || ahead < 0) {         // Already taken or given up on, a retransmission or replay
+      n.Stats.Duplicates++;
+      return INGEST_DUPLICATE;
+    }
+    n.Stats.LastSeenMs = nowMs;
+    if (ahead >= (int32_t)WINDOW) {
+      skip(slot, seq - WINDOW + 1);           // Too far ahead to hold, give up on the oldest gaps
+    }
+    Pending &p = n.Window[seq % WINDOW];
+    if (p.Valid && p.Seq == seq) {
+      n.Stats.Duplicates++;
+      return INGEST_DUPLICATE;
+    }
+    p.Valid = true;
+    p.Seq = seq;
+    p.Count = count;
+    p.ArrivedMs = nowMs;
+    memcpy(p.Data, data + SENSOR_PACKET_HEADER, count * SENSOR_PACKET_READING);
+    n.Stats.Packets++;
+    if ((int32_t)(seq - n.Highest) < 0) n.Stats.Reordered++;
+    else n.Highest = seq;
+    drain(slot);
+    return INGEST_ACCEPTED;
+  }
+
+  // Gives up on gaps that have held later packets back for longer than the reorder timeout
+  void expire(uint32_t nowMs) {
+    for (size_t slot = 0; slot < _count; slot++) {
+      Node &n = _nodes[slot];
+      for (size_t i = 1; i < WINDOW; i++) {
+        const Pending &p = n.Window[(n.Next + i) % WINDOW];
+        if (p.Valid && p.Seq == n.Next + i) {
+          if (nowMs - p.ArrivedMs >= _timeoutMs) skip(slot, n.Next + i);
+          break;
+        }
+      }
+    }
+  }
+
+  size_t nodes() const { return _count; }
+  const SensorNodeStats &node(size_t slot) const { return _nodes[slot].Stats; }
+  uint32_t malformed() const { return _malformed; }
+  uint32_t unauthenticated() const { return _unauthenticated; }
+  uint32_t noRoom() const { return _noRoom; }
+
+private:
+  struct Pending {
+    bool     Valid = false;
+    uint32_t Seq = 0;
+    uint32_t ArrivedMs = 0;
+    uint8_t  Count = 0;
+    uint8_t  Data[SENSOR_PACKET_BATCH * SENSOR_PACKET_READING];
+  };
+
+  struct Node {
+    bool     Started = false;
+    uint32_t Boot = 0;                        // Boot number of the sequence being followed
+    uint32_t Next = 0;                        // Next sequence number to hand on
+    uint32_t Highest = 0;                     // Highest sequence number taken
+    SensorNodeStats Stats;
+    Pending  Window[WINDOW];
+  };
+
+  IngestResult reject(IngestResult result) {
+    if (result == INGEST_MALFORMED) _malformed++;
+    else if (result == INGEST_UNAUTHENTICATED) _unauthenticated++;
+    else if (result == INGEST_NO_ROOM) _noRoom++;
+    return result;
+  }
+
+  int findNode(uint8_t id) {
+    for (size_t i = 0; i < _count; i++) {
+      if (_nodes[i].Stats.Node == id) return i;
+    }
+    if (_count >= MAX_NODES) return -1;
+    _nodes[_count].Stats.Node = id;
+    return _count++;
+  }
+
+  void restart(size_t slot, uint32_t boot, uint32_t seq) {
+    Node &n = _nodes[slot];
+    skip(slot, n.Highest + 1);                // Hand on whatever was held before starting again
+    for (size_t i = 0; i < WINDOW; i++) n.Window[i].Valid = false;
+    n.Boot = boot;
+    n.Next = n.Highest = seq;
+    n.Stats.Restarts++;
+  }
+
+  // Moves the expected sequence number on to next, handing on held packets and counting the gaps as lost
+  void skip(size_t slot, uint32_t next) {
+    Node &n = _nodes[slot];
+    uint32_t gap = next - n.Next;
+    if (gap > WINDOW) {                       // Nothing held beyond the window, jump straight over the rest
+      for (size_t i = 0; i < WINDOW; i++) deliverOrLose(slot, n.Next + i);
+      n.Stats.Lost += gap - WINDOW;
+      n.Next = next;
+    }
+    else {
+      while (n.Next != next) deliverOrLose(slot, n.Next++);
+    }
+    drain(slot);
+  }
+
+  void deliverOrLose(size_t slot, uint32_t seq) {
+    Pending &p = _nodes[slot].Window[seq % WINDOW];
+    if (p.Valid && p.Seq == seq) deliver(slot, p);
+    else _nodes[slot].Stats.Lost++;
+  }
+
+  void drain(size_t slot) {
+    Node &n = _nodes[slot];
+    for (;;) {
+      Pending &p = n.Window[n.Next % WINDOW];
+      if (!p.Valid || p.Seq != n.Next) break;
+      deliver(slot, p);
+      n.Next++;
+    }
+  }
+
+  void deliver(size_t slot, Pending &p) {
+    SensorReading readings[SENSOR_PACKET_BATCH];
+    SensorNodeStats &stats = _nodes[slot].Stats;
+    for (size_t r = 0; r < p.Count; r++) {
+      const uint8_t *d = p.Data + r * SENSOR_PACKET_READING;
+      readings[r].Temp = (int16_t)(d[0] | d[1] << 8) / 100.0f;
+      readings[r].Humi = d[2];
+      readings[r].Battery = d[3];
+    }
+    p.Valid = false;
+    stats.Readings += p.Count;
+    stats.Last = readings[p.Count - 1];
+    if (_deliver) _deliver(slot, stats, readings, p.Count);
+  }
+
+  uint8_t  _key[16] = {0};
+  Deliver  _deliver = nullptr;
+  uint32_t _timeoutMs = 0;
+  Node     _nodes[MAX_NODES];
+  size_t   _count = 0;
+  uint32_t _malformed = 0;
+  uint32_t _unauthenticated = 0;
+  uint32_t _noRoom = 0;
+};
@@ -0,0 +1,196 @@
+// Deferred logging: the caller stores a message id and up to five binary arguments in a lock-free ring buffer,
+// formatting and output happen later in a low-priority task, so logging never blocks or allocates.
+// Messages below THERMOSTAT_LOG_LEVEL are removed at compile time.
+#pragma once
+
+#include <atomic>
+#include <initializer_list>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+enum LogLevel : uint8_t {
+  LOG_LEVEL_ERROR = 0,
+  LOG_LEVEL_WARN  = 1,
+  LOG_LEVEL_INFO  = 2,
+  LOG_LEVEL_DEBUG = 3
+};
+
+enum LogArgType : uint8_t {
+  LOG_ARG_INT    = 0,
+  LOG_ARG_FLOAT  = 1,
+  LOG_ARG_STRING = 2        // Pointer only, the text must outlive the record, e.g. a literal or a constant
+};
+
+struct LogArg {
+  union {
+    int32_t     Int;
+    float       Float;
+    const char *String;
+  };
+  LogArgType Type;
+
+  LogArg(int v) : Int(v), Type(LOG_ARG_INT) {}
+  LogArg(unsigned v) : Int(v), Type(LOG_ARG_INT) {}
+  LogArg(long v) : Int(v), Type(LOG_ARG_INT) {}
+  LogArg(unsigned long v) : Int(v), Type(LOG_ARG_INT) {}
+  LogArg(bool v) : Int(v), Type(LOG_ARG_INT) {}
+  LogArg(float v) : Float(v), Type(LOG_ARG_FLOAT) {}
+  LogArg(double v) : Float(v), Type(LOG_ARG_FLOAT) {}
+  LogArg(const char *v) : String(v), Type(LOG_ARG_STRING) {}
+};
+
+struct LogRecord {
+  static const size_t MAX_ARGS = 5;
+  uint32_t Ms;              // millis() when logged
+  uint16_t Id;              // Index into the message format table
+  uint8_t  Level;
+  uint8_t  Count;
+  uint8_t  Types[MAX_ARGS];
+  union {
+    int32_t     Int;
+    float       Float;
+    const char *String;
+  } Args[MAX_ARGS];
+};
+
+inline const char *logLevelName(uint8_t level) {
+  static const char *const NAMES[] = {"ERROR", "WARN", "INFO", "DEBUG"};
+  return level <= LOG_LEVEL_DEBUG ? NAMES[level] : "?";
+}
+
+// Bounded multi-producer single-consumer queue, producers never wait and drop the record when full.
+// N must be a power of 2.
+template <size_t N>
+class LogRing {
+public:
+  LogRing() {
+    for (size_t i = 0; i < N; i++) _slots[i].Seq.store(i, std::memory_order_relaxed);
+  }
+
+  bool push(uint32_t ms, uint8_t level, uint16_t id, std::initializer_list<LogArg> args) {
+    uint32_t pos = _head.load(std::memory_order_relaxed);
+    Slot *slot;
+    for (;;) {
+      slot = &_slots[pos & (N - 1)];
+      int32_t diff = (int32_t)(slot->Seq.load(std::memory_order_acquire) - pos);
+      if (diff == 0) {
+        if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+      }
+      else if (diff < 0) {                    // Consumer has not caught up, drop rather than block
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+      else {
+        pos = _head.load(std::memory_order_relaxed);
+      }
+    }
+    LogRecord &r = slot->Record;
+    r.Ms = ms;
+    r.Id = id;
+    r.Level = level;
+    r.Count = 0;
+    for (const LogArg &a : args) {
+      if (r.Count >= LogRecord::MAX_ARGS) break;
+      r.Types[r.Count] = a.Type;
+      if (a.Type == LOG_ARG_FLOAT) r.Args[r.Count].Float = a.Float;
+      else if (a.Type == LOG_ARG_STRING) r.Args[r.Count].String = a.String;
+      else r.Args[r.Count].Int = a.Int;
+      r.Count++;
+    }
+    slot->Seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Single consumer only
+  bool pop(LogRecord &out) {
+    Slot &slot = _slots[_tail & (N - 1)];
+    if ((int32_t)(slot.Seq.load(std::memory_order_acquire) - (_tail + 1)) < 0) return false;
+    out = slot.Record;
+    slot.Seq.store(_tail + N, std::memory_order_release);
+    _tail++;
+    return true;
+  }
+
+  uint32_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+private:
+  struct Slot {
+    std::atomic<uint32_t> Seq;
+    LogRecord Record;
+  };
+  Slot _slots[N];
+  std::atomic<uint32_t> _head{0};
+  std::atomic<uint32_t> _dropped{0};
+  uint32_t _tail = 0;
+};
+
+// Expands a printf style format with the record arguments, each conversion takes the next argument.
+// %M is an extra conversion that prints an integer number of minutes as HH:MM.
+inline size_t formatLogRecord(const LogRecord &r, const char *format, char *out, size_t size) {
+  size_t len = 0, arg = 0;
+  if (size == 0) return 0;
+  for (const char *p = format; *p && len + 1 < size; p++) {
+    if (*p != '%' || p[1] == '%' || p[1] == 0) {
+      out[len++] = *p;
+      if (*p == '%' && p[1] == '%') p++;
+      continue;
+    }
+    char spec[16];
+    size_t n = 0;
+    spec[n++] = *p++;
+    while (*p && n < sizeof(spec) - 2 && strchr("-+ #0123456789.l", *p)) spec[n++] = *p++;
+    if (*p == 0) break;
+    char conversion = *p;
+    int written = 0;
+    if (arg >= r.Count) {
+      written = snprintf(out + len, size - len, "?");
+    }
+    else if (conversion == 'M') {
+      int32_t minutes = r.Types[arg] == LOG_ARG_FLOAT ? (int32_t)r.Args[arg].Float : r.Args[arg].Int;
+      if (minutes < 0) written = snprintf(out + len, size - len, "--:--");
+      else written = snprintf(out + len, size - len, "%02d:%02d", (int)(minutes / 60), (int)(minutes % 60));
+    }
+    else if (conversion == 's') {
+      spec[n++] = 's'; spec[n] = 0;
+      written = snprintf(out + len, size - len, spec, r.Types[arg] == LOG_ARG_STRING && r.Args[arg].String ? r.Args[arg].String : "?");
+    }
+    else if (strchr("feEgG", conversion)) {
+      spec[n++] = conversion; spec[n] = 0;
+      written = snprintf(out + len, size - len, spec, r.Types[arg] == LOG_ARG_FLOAT ? (double)r.Args[arg].Float : (double)r.Args[arg].Int);
+    }
+    else if (strchr("diouxX", conversion)) {
+      while (n > 1 && spec[n - 1] == 'l') n--; // Arguments are 32-bit, drop any length modifier and add our own
+      spec[n++] = 'l'; spec[n++] = conversion; spec[n] = 0;
+      written = snprintf(out + len, size - len, spec, r.Types[arg] == LOG_ARG_FLOAT ? (long)r.Args[arg].Float : (long)r.Args[arg].Int);
+    }
+    else {
+      spec[n++] = conversion; spec[n] = 0;    // e.g. %c
+      written = snprintf(out + len, size - len, spec, r.Types[arg] == LOG_ARG_FLOAT ? (int)r.Args[arg].Float : (int)r.Args[arg].Int);
+    }
+    arg++;
+    if (written > 0) len += ((size_t)written < size - len) ? (size_t)written : size - len - 1;
+  }
+  out[len] = 0;
+  return len;
+}
+
+#ifndef THERMOSTAT_LOG_LEVEL
+#define THERMOSTAT_LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// Only declared, sizeof the result gives the number of arguments + 1 at compile time without evaluating them
+template <class... T>
+char (&logArgCount(const T &...))[sizeof...(T) + 1];
+
+// Records go to the LogRing named _log defined by the application.
+// The level test is a constant expression, so filtered out messages generate no code
+#define LOG_AT(level, id, ...) do { \
+    static_assert(sizeof(logArgCount(__VA_ARGS__)) - 1 <= LogRecord::MAX_ARGS, "too many log arguments, raise LogRecord::MAX_ARGS"); \
+    if ((level) <= THERMOSTAT_LOG_LEVEL) _log.push(millis(), (level), (id), {__VA_ARGS__}); \
+  } while (0)
+#define LOG_ERROR(id, ...) LOG_AT(LOG_LEVEL_ERROR, id, ##__VA_ARGS__)
+#define LOG_WARN(id, ...)  LOG_AT(LOG_LEVEL_WARN,  id, ##__VA_ARGS__)
+#define LOG_INFO(id, ...)  LOG_AT(LOG_LEVEL_INFO,  id, ##__VA_ARGS__)
+#define LOG_DEBUG(id, ...) LOG_AT(LOG_LEVEL_DEBUG, id, ##__VA_ARGS__)
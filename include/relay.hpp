@@ -0,0 +1,140 @@
+// Relay actuator state, kept apart from the pin driver so that it only reports real transitions.
+// Enforces minimum on/off dwell times, journals each transition in a ring buffer and accounts the
+// heater on-time into hourly and daily buckets as it goes, so duty cycle and energy are always ready to read.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct RelayTransition {
+  uint32_t Time = 0;        // Unix time of the transition, 0 when the clock was not yet set
+  bool     On   = false;
+};
+
+struct RelayDutyBucket {
+  uint32_t Index     = 0;   // Hour or day number since the epoch, identifies the period held in the slot
+  uint32_t OnSeconds = 0;
+};
+
+template <size_t JOURNAL_SIZE>
+class RelayActuator {
+public:
+  static const size_t HOURS = 24;
+  static const size_t DAYS  = 7;
+
+  void configure(uint32_t minOnSecs, uint32_t minOffSecs) {
+    _minOnMs  = minOnSecs * 1000;
+    _minOffMs = minOffSecs * 1000;
+  }
+
+  // Sets the initial state without dwell checks, the caller drives the output unconditionally
+  void begin(bool on, uint32_t nowMs) {
+    _on = on;
+    _started = true;
+    _lastChangeMs = nowMs;
+    _lastUpdateMs = nowMs;
+    _holdOff = true;                          // Dwell timers are not known after a restart, so allow the first change
+    _held = false;
+  }
+
+  // Returns true when the output has to change; false when already in that state or held by a dwell time.
+  // Forced requests, e.g. over-temperature, skip the dwell check.
+  bool request(bool demand, uint32_t nowMs, uint32_t epoch, bool force = false) {
+    if (_started && demand == _on) {
+      _held = false;                          // Any held change is no longer wanted
+      return false;
+    }
+    if (_started && !force && !_holdOff) {
+      uint32_t dwell = _on ? _minOnMs : _minOffMs;
+      if (nowMs - _lastChangeMs < dwell) {
+        if (!_held) _deferred++;              // Counted once per held change, not on every control pass
+        _held = true;
+        return false;
+      }
+    }
+    update(nowMs, epoch);
+    _on = demand;
+    _started = true;
+    _holdOff = false;
+    _held = false;
+    _lastChangeMs = nowMs;
+    _journal[_journalHead].Time = epoch;
+    _journal[_journalHead].On = demand;
+    _journalHead = (_journalHead + 1) % JOURNAL_SIZE;
+    if (_journalCount < JOURNAL_SIZE) _journalCount++;
+    _transitions++;
+    return true;
+  }
+
+  // Accrues on-time up to now, call regularly so that the buckets stay current between transitions
+  void update(uint32_t nowMs, uint32_t epoch) {
+    if (_on) _onMs += nowMs - _lastUpdateMs;
+    _lastUpdateMs = nowMs;
+    if (epoch == 0) return;                   // No wall clock yet, only the monotonic total is kept
+    if (_accountedTo == 0 || epoch < _accountedTo) _accountedTo = epoch;
+    while (_accountedTo < epoch) {
+      uint32_t hourEnd = (_accountedTo / 3600 + 1) * 3600;
+      uint32_t until = epoch < hourEnd ? epoch : hourEnd;
+      if (_on) {
+        addTo(_hours, HOURS, _accountedTo / 3600, until - _accountedTo);
+        addTo(_days, DAYS, (_accountedTo + _dayOffset) / 86400, until - _accountedTo);
+      }
+      _accountedTo = until;
+    }
+  }
+
+  // Shifts the day boundaries from UTC to local midnight
+  void setUtcOffset(int32_t seconds) { _dayOffset = seconds; }
+
+  bool isOn() const { return _on; }
+  uint32_t transitions() const { return _transitions; }
+  uint32_t deferred() const { return _deferred; }          // Changes held back by a dwell time
+  uint32_t lastChangeMs() const { return _lastChangeMs; }
+
+  // Total on-time in ms including the current on period, wraps with millis()
+  uint32_t onMs(uint32_t nowMs) const { return _onMs + (_on ? nowMs - _lastUpdateMs : 0); }
+
+  // On-seconds for the hour or day holding time t (days by local midnight), 0 when it has aged out
+  uint32_t hourOnSeconds(uint32_t t) const { return lookup(_hours, HOURS, t / 3600); }
+  uint32_t dayOnSeconds(uint32_t t) const { return lookup(_days, DAYS, (t + _dayOffset) / 86400); }
+
+  // Journal entries in order, 0 is the oldest
+  size_t journalSize() const { return _journalCount; }
+  const RelayTransition &journal(size_t i) const {
+    return _journal[(_journalHead + JOURNAL_SIZE - _journalCount + i) % JOURNAL_SIZE];
+  }
+
+private:
+  static void addTo(RelayDutyBucket *buckets, size_t n, uint32_t index, uint32_t secs) {
+    RelayDutyBucket &b = buckets[index % n];
+    if (b.Index != index) {                   // Slot holds an older period, recycle it
+      b.Index = index;
+      b.OnSeconds = 0;
+    }
+    b.OnSeconds += secs;
+  }
+
+  static uint32_t lookup(const RelayDutyBucket *buckets, size_t n, uint32_t index) {
+    const RelayDutyBucket &b = buckets[index % n];
+    return b.Index == index ? b.OnSeconds : 0;
+  }
+
+  bool     _on = false;
+  bool     _started = false;
+  bool     _holdOff = false;
+  bool     _held = false;                     // A requested change is waiting for its dwell time
+  uint32_t _minOnMs = 0;
+  uint32_t _minOffMs = 0;
+  uint32_t _lastChangeMs = 0;
+  uint32_t _lastUpdateMs = 0;
+  uint32_t _onMs = 0;
+  uint32_t _accountedTo = 0;
+  int32_t  _dayOffset = 0;
+  uint32_t _transitions = 0;
+  uint32_t _deferred = 0;
+  RelayDutyBucket _hours[HOURS];
+  RelayDutyBucket _days[DAYS];
+  RelayTransition _journal[JOURNAL_SIZE];
+  size_t _journalHead = 0;
+  size_t _journalCount = 0;
+};
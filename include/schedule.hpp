@@ -0,0 +1,143 @@
+// Schedule resolution and heating control decisions, shared by the thermostat and the schedule simulator.
+// Pure functions of the weekly schedule, calendar exception, settings and temperature, so that a candidate
+// schedule can be replayed offline with exactly the code that runs on the device.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "calendar.hpp"
+
+const int SCHEDULE_PERIODS = 4;          // Heating periods per day
+
+struct SchedulePeriod {
+  int16_t Start = -1;                    // Minutes from midnight, -1 when the period is unused
+  int16_t Stop  = -1;
+  float   Temp  = 0;
+
+  bool active() const { return Start >= 0 && Stop >= 0; }
+};
+
+struct WeeklySchedule {
+  SchedulePeriod Days[7][SCHEDULE_PERIODS]; // 0 = Sun
+};
+
+struct ControlSettings {
+  float Hysteresis      = 0.2;
+  float FrostTemp       = 5;
+  int   EarlyStart      = 0;             // Minutes
+  float ManOverrideTemp = 21;
+  float MaxTemperature  = 28;
+  int   MinOnTime       = 0;             // Minutes, used by the relay
+  int   MinOffTime      = 0;
+};
+
+// Carried from one control pass to the next
+struct ControlState {
+  float TargetTemp     = 20;             // Keeps its value outside scheduled periods
+  bool  ManualOverride = false;          // Set and cleared from the web interface
+};
+
+enum ControlDemand : int8_t {
+  DEMAND_NONE = -1,                      // Leave the relay as it is, e.g. inside the hysteresis band
+  DEMAND_OFF  = 0,
+  DEMAND_ON   = 1
+};
+
+struct ControlResult {
+  bool          TimerOn = false;
+  ControlDemand Demand  = DEMAND_NONE;
+  bool          Force   = false;         // Over-temperature, switch OFF regardless of minimum ON time
+  bool          Frost   = false;         // Frost protection asked for heat
+};
+
+// Parses 'HH:MM', returns minutes from midnight or -1 when blank or malformed
+inline int parseClock(const char *text) {
+  if (!text || text[0] < '0' || text[0] > '9' || text[1] < '0' || text[1] > '9' || text[2] != ':' ||
+      text[3] < '0' || text[3] > '9' || text[4] < '0' || text[4] > '9') return -1;
+  int hours = (text[0] - '0') * 10 + text[1] - '0', minutes = (text[3] - '0') * 10 + text[4] - '0';
+  return (hours < 24 && minutes < 60) ? hours * 60 + minutes : -1;
+}
+
+// Day of week (0 = Sun) and minute of the day of a Unix time already shifted to local time
+inline int localDayOfWeek(uint32_t localTime) { return (localTime / 86400 + 4) % 7; } // 1 Jan 1970 was a Thursday
+inline int localMinuteOfDay(uint32_t localTime) { return localTime % 86400 / 60; }
+
+inline void controlHeating(const ControlSettings &settings, float target, float temperature, ControlResult &result) {
+  if (temperature < target - settings.Hysteresis) result.Demand = DEMAND_ON;   // Below set-point and hysteresis offset
+  if (temperature > target + settings.Hysteresis) result.Demand = DEMAND_OFF;  // Above set-point and hysteresis offset
+}
+
+// One control pass: resolves the set-point from the schedule, calendar exception and manual override, then decides the relay demand.
+// upcoming is the exception in force at the end of the early start time, so that tomorrow's timetable is resolved like today's.
+// dayOfWeek is -1 while the clock is not set, then neither the schedule nor the calendar apply, only manual override and frost protection.
+inline ControlResult evaluateControl(const WeeklySchedule &schedule, const ControlSettings &settings, ControlState &state,
+                                     int dayOfWeek, int minuteOfDay, const CalendarException *exception,
+                                     const CalendarException *upcoming, float temperature) {
+  ControlResult result;
+  bool overTemperature = temperature > settings.MaxTemperature;  // Fault/over-temperature, whatever set the demand
+  bool clockSet = dayOfWeek >= 0;
+  if (!clockSet) exception = upcoming = nullptr;
+  int day = (exception && exception->Kind == EXCEPTION_HOLIDAY) ? (int)exception->Value : dayOfWeek; // Holidays follow another day's profile
+  for (int p = 0; p < SCHEDULE_PERIODS && clockSet; p++) {
+    const SchedulePeriod &period = schedule.Days[day][p];
+    if (period.active() && minuteOfDay >= period.Start && minuteOfDay < period.Stop) state.TargetTemp = period.Temp;
+  }
+  if (exception && exception->Kind == EXCEPTION_SETPOINT) state.TargetTemp = exception->Value;  // One-off set-point replaces the schedule
+  if (exception && exception->Kind == EXCEPTION_AWAY)     state.TargetTemp = settings.FrostTemp; // Away, only frost protection applies
+
+  if (state.ManualOverride) {
+    state.TargetTemp = settings.ManOverrideTemp;
+    controlHeating(settings, state.TargetTemp, temperature, result);
+  }
+  else if (exception && exception->Kind == EXCEPTION_AWAY) {
+    // Schedule suspended, the timer stays OFF so that frost protection takes over
+  }
+  else if (exception && exception->Kind == EXCEPTION_SETPOINT) {
+    result.TimerOn = true;
+    controlHeating(settings, state.TargetTemp, temperature, result);
+  }
+  else if (clockSet) {
+    for (int p = 0; p < SCHEDULE_PERIODS; p++) {        // Periods in progress, until their Stop time
+      const SchedulePeriod &period = schedule.Days[day][p];
+      if (period.active() && minuteOfDay >= period.Start && minuteOfDay <= period.Stop) {
+        result.TimerOn = true;
+        state.TargetTemp = period.Temp;
+        controlHeating(settings, state.TargetTemp, temperature, result);
+      }
+    }
+    // Periods starting within the early start time, into the next day if need be. Away and set-point
+    // exceptions replace the schedule, so there is nothing to heat towards when one is due by then.
+    if (settings.EarlyStart > 0 && (!upcoming || upcoming->Kind == EXCEPTION_HOLIDAY)) {
+      int ahead = minuteOfDay + settings.EarlyStart, aheadDay = dayOfWeek;
+      bool nextDay = ahead >= 1440;
+      if (nextDay) {
+        ahead -= 1440;
+        aheadDay = (dayOfWeek + 1) % 7;
+      }
+      if (upcoming) aheadDay = (int)upcoming->Value;
+      for (int p = 0; p < SCHEDULE_PERIODS; p++) {
+        const SchedulePeriod &period = schedule.Days[aheadDay][p];
+        bool upcoming = nextDay || minuteOfDay < period.Start;
+        if (period.active() && upcoming && ahead >= period.Start && ahead <= period.Stop) {
+          result.TimerOn = true;
+          state.TargetTemp = period.Temp;               // Heat towards the coming period's set-point
+          controlHeating(settings, state.TargetTemp, temperature, result);
+        }
+      }
+    }
+  }
+
+  if (!result.TimerOn && !state.ManualOverride) {       // Frost protection only when the heating is otherwise off
+    if (temperature < settings.FrostTemp - settings.Hysteresis) {
+      result.Demand = DEMAND_ON;
+      result.Frost = true;
+    }
+    if (temperature > settings.FrostTemp + settings.Hysteresis) result.Demand = DEMAND_OFF;
+  }
+  if (overTemperature) {
+    result.Demand = DEMAND_OFF;
+    result.Force = true;
+    result.Frost = false;
+  }
+  return result;
+}
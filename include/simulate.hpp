@@ -0,0 +1,127 @@
+// Schedule preview: replays a candidate schedule and settings over a period, one control pass per simulated minute,
+// through the same evaluateControl() and relay minimum ON/OFF handling the thermostat uses.
+// Room temperature comes either from a recorded trace (open loop, the heating does not change it) or from a
+// first-order thermal model (closed loop).
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "schedule.hpp"
+#include "relay.hpp"
+
+const uint32_t SIMULATION_WEEK = 7 * 24 * 60;  // Minutes
+
+// Room losing heat to the outside in proportion to the difference, and gaining a fixed rate while the heating is ON
+struct ThermalModel {
+  float StartTemp   = 18;
+  float Outside     = 5;
+  float LossPerHour = 0.1;                     // Fraction of the inside/outside difference lost per hour
+  float GainPerHour = 4;                       // Degrees per hour added by the heating
+};
+
+// Recorded temperatures, repeated when shorter than the simulated period
+struct TemperatureTrace {
+  const float *Temps = nullptr;
+  size_t   Count     = 0;
+  uint32_t Minutes   = 1;                      // Time between readings
+};
+
+struct SimulationResult {
+  uint32_t Minutes       = 0;
+  uint32_t TimerMinutes  = 0;                  // Time a schedule period, set-point exception or manual override was in force
+  uint32_t HeatMinutes   = 0;
+  uint32_t FrostMinutes  = 0;                  // Heating demanded by frost protection
+  uint32_t Switches      = 0;
+  uint32_t Deferred      = 0;                  // Relay changes held back by the minimum ON/OFF time
+  uint32_t MinutesBelow  = 0;                  // Timer ON and below the target by more than the hysteresis
+  float    DegreeHours   = 0;                  // Timer ON, sum of (target - temperature) x hours while below target
+  float    ErrorSum      = 0;                  // Timer ON, sum of |temperature - target|
+  float    TempMin       = 0;
+  float    TempMax       = 0;
+
+  float comfortError() const { return TimerMinutes ? ErrorSum / TimerMinutes : 0; } // Mean absolute error while the timer is ON
+};
+
+// Receives the simulated timeline as it is produced, so that callers can stream it without buffering the week
+class SimulationObserver {
+public:
+  virtual ~SimulationObserver() {}
+  // The target or timer state changed: minute of the simulation, target temperature, timer ON
+  virtual void setpoint(uint32_t, float, bool) {}
+  // Summary of one simulated hour: hour of the simulation, mean temperature, heating ON minutes
+  virtual void hour(uint32_t, float, uint32_t) {}
+};
+
+// startTime is Unix time, utcOffset shifts it to local time for the schedule; exceptions is any object with
+// find(uint32_t), such as ExceptionCalendar, or nullptr for none
+template <class Calendar>
+SimulationResult simulateSchedule(const WeeklySchedule &schedule, const ControlSettings &settings, ControlState state,
+                                  const Calendar *exceptions, uint32_t startTime, int32_t utcOffset, uint32_t minutes,
+                                  const TemperatureTrace &trace, const ThermalModel &model, SimulationObserver *observer) {
+  SimulationResult result;
+  RelayActuator<1> relay;
+  relay.configure(settings.MinOnTime * 60, settings.MinOffTime * 60);
+  relay.begin(false, 0);
+  bool replay = trace.Temps && trace.Count > 0;
+  float temperature = replay ? trace.Temps[0] : model.StartTemp;
+  result.TempMin = result.TempMax = temperature;
+  float lastTarget = NAN, hourTemp = 0;
+  bool lastTimer = false;
+  uint32_t hourHeat = 0;
+
+  for (uint32_t m = 0; m < minutes; m++) {
+    uint32_t now = startTime + m * 60, local = now + utcOffset;
+    if (replay) temperature = trace.Temps[(m / (trace.Minutes ? trace.Minutes : 1)) % trace.Count];
+    const CalendarException *exception = exceptions ? exceptions->find(now) : nullptr;
+    const CalendarException *upcoming = exceptions ? exceptions->find(now + settings.EarlyStart * 60) : nullptr;
+    ControlResult control = evaluateControl(schedule, settings, state, localDayOfWeek(local), localMinuteOfDay(local), exception,
+                                            upcoming, temperature);
+    if (control.Demand != DEMAND_NONE) relay.request(control.Demand == DEMAND_ON, m * 60000, now, control.Force);
+    bool timerOn = control.TimerOn || state.ManualOverride;
+    bool heating = relay.isOn();
+
+    if (state.TargetTemp != lastTarget || timerOn != lastTimer) {
+      if (observer) observer->setpoint(m, state.TargetTemp, timerOn);
+      lastTarget = state.TargetTemp;
+      lastTimer = timerOn;
+    }
+    if (heating) result.HeatMinutes++;
+    if (control.Frost) result.FrostMinutes++;
+    if (timerOn) {
+      float error = temperature - state.TargetTemp;
+      result.TimerMinutes++;
+      result.ErrorSum += fabsf(error);
+      if (error < 0) result.DegreeHours += -error / 60;
+      if (error < -settings.Hysteresis) result.MinutesBelow++;
+    }
+    if (temperature < result.TempMin) result.TempMin = temperature;
+    if (temperature > result.TempMax) result.TempMax = temperature;
+    hourTemp += temperature;
+    if (heating) hourHeat++;
+    if (m % 60 == 59 || m + 1 == minutes) {
+      if (observer) observer->hour(m / 60, hourTemp / (m % 60 + 1), hourHeat);
+      hourTemp = 0;
+      hourHeat = 0;
+    }
+
+    if (!replay) temperature += ((heating ? model.GainPerHour : 0) - model.LossPerHour * (temperature - model.Outside)) / 60;
+  }
+  result.Minutes = minutes;
+  result.Switches = relay.transitions();
+  result.Deferred = relay.deferred();
+  return result;
+}
+
+// Summary of a simulation as JSON members, without the enclosing braces, so the device and the native tool report alike
+inline int formatSimulationSummary(const SimulationResult &result, float heaterPower, char *out, size_t size) {
+  return snprintf(out, size,
+                  "\"minutes\":%u,\"timer_minutes\":%u,\"heat_minutes\":%u,\"energy_kwh\":%.2f,\"frost_minutes\":%u,"
+                  "\"switches\":%u,\"deferred\":%u,\"minutes_below\":%u,\"degree_hours\":%.2f,\"comfort_error\":%.2f,"
+                  "\"temp_min\":%.1f,\"temp_max\":%.1f",
+                  (unsigned)result.Minutes, (unsigned)result.TimerMinutes, (unsigned)result.HeatMinutes,
+                  result.HeatMinutes * heaterPower / 60000.0, (unsigned)result.FrostMinutes, (unsigned)result.Switches,
+                  (unsigned)result.Deferred, (unsigned)result.MinutesBelow, result.DegreeHours, result.comfortError(),
+                  result.TempMin, result.TempMax);
+}
@@ -0,0 +1,76 @@
+// Hourly and daily comfort and energy aggregates, updated in constant time and memory as each reading arrives.
+// Periods are identified by their hour or day number, so a slot holding an older period is recycled on first use.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct ComfortStats {
+  uint32_t Index        = 0;   // Hour or day number of local time since the epoch
+  uint32_t Samples      = 0;
+  float    TempMin      = 0;
+  float    TempMax      = 0;
+  float    TempSum      = 0;
+  float    HumiMin      = 0;
+  float    HumiMax      = 0;
+  float    HumiSum      = 0;
+  uint32_t Seconds      = 0;   // Time covered by the samples
+  uint32_t SecondsBelow = 0;   // Time below the target by more than the hysteresis band
+  uint32_t SecondsAbove = 0;   // Time above the target by more than the hysteresis band
+  float    DegreeHours  = 0;   // Heating demand, sum of (target - temperature) x hours while below target
+  uint32_t HeatSeconds  = 0;   // Heater ON time
+
+  float tempMean() const { return Samples ? TempSum / Samples : 0; }
+  float humiMean() const { return Samples ? HumiSum / Samples : 0; }
+
+  void add(uint32_t seconds, float temp, float humi, float target, float band, uint32_t heatSeconds) {
+    if (Samples == 0) {
+      TempMin = TempMax = temp;
+      HumiMin = HumiMax = humi;
+    }
+    if (temp < TempMin) TempMin = temp;
+    if (temp > TempMax) TempMax = temp;
+    if (humi < HumiMin) HumiMin = humi;
+    if (humi > HumiMax) HumiMax = humi;
+    TempSum += temp;
+    HumiSum += humi;
+    Samples++;
+    Seconds += seconds;
+    if (temp < target - band) SecondsBelow += seconds;
+    if (temp > target + band) SecondsAbove += seconds;
+    if (temp < target) DegreeHours += (target - temp) * seconds / 3600.0f;
+    HeatSeconds += heatSeconds;
+  }
+};
+
+template <size_t HOURS, size_t DAYS>
+class ComfortStatistics {
+public:
+  // localTime is Unix time shifted to local time, so that days run from local midnight
+  void add(uint32_t localTime, uint32_t seconds, float temp, float humi, float target, float band, uint32_t heatSeconds) {
+    slot(_hours, HOURS, localTime / 3600).add(seconds, temp, humi, target, band, heatSeconds);
+    slot(_days, DAYS, localTime / 86400).add(seconds, temp, humi, target, band, heatSeconds);
+  }
+
+  // Aggregates for the hour or day holding localTime, nullptr when there are none
+  const ComfortStats *hour(uint32_t localTime) const { return find(_hours, HOURS, localTime / 3600); }
+  const ComfortStats *day(uint32_t localTime) const { return find(_days, DAYS, localTime / 86400); }
+
+private:
+  static ComfortStats &slot(ComfortStats *periods, size_t n, uint32_t index) {
+    ComfortStats &s = periods[index % n];
+    if (s.Index != index || s.Samples == 0) {
+      s = ComfortStats();
+      s.Index = index;
+    }
+    return s;
+  }
+
+  static const ComfortStats *find(const ComfortStats *periods, size_t n, uint32_t index) {
+    const ComfortStats &s = periods[index % n];
+    return (s.Index == index && s.Samples > 0) ? &s : nullptr;
+  }
+
+  ComfortStats _hours[HOURS];
+  ComfortStats _days[DAYS];
+};
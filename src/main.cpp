@@ -21,20 +21,40 @@
 #include <WiFi.h>                      // Built-in
 #include <ESPmDNS.h>                   // Built-in
 #include <SPIFFS.h>                    // Built-in
+#include <WiFiUdp.h>                   // Built-in
+#include <esp_system.h>                // Built-in
+#include <sys/time.h>
 #include "ESPAsyncWebServer.h"         // https://github.com/me-no-dev/ESPAsyncWebServer/tree/63b5303880023f17e1bca517ac593d8a33955e94
 #include "AsyncTCP.h"                  // https://github.com/me-no-dev/AsyncTCP
 #include <Wire.h>
 #include "SHTSensor.h"
 #include "config.hpp"
+#include "calendar.hpp"
+#include "relay.hpp"
+#include "log.hpp"
+#include "stats.hpp"
+#include "admission.hpp"
+#include "ingest.hpp"
+#include "checkpoint.hpp"
+#include "schedule.hpp"
+#include "simulate.hpp"
 
 //################ CONSTANTS ################
 const int MAX_SENSOR_READINGS=144;         // maximum number of sensor readings, typically 144/day at 6-per-hour
-const int NUM_OF_SENSORS=2;              // number of sensors (+1), set by the graphing section
+const int REMOTE_SENSORS=4;              // Remote battery sensor nodes accepted over UDP
+const int NUM_OF_SENSORS=2+REMOTE_SENSORS; // number of sensors (+1), sensor 1 is local, remote nodes follow from 2
+const int REMOTE_SENSOR_CHANNEL=2;       // History channel of the first remote node
+const int REMOTE_REORDER_WINDOW=8;       // Out of order packets held per node while waiting for a missing one
+const int REMOTE_REORDER_TIMEOUT=30000;  // ms to wait for a missing packet before counting it lost
+const int REMOTE_PACKETS_PER_LOOP=16;    // Most packets read in one loop() pass, keeps control responsive under load
 const bool NO_REFRESH=false;          // Set auto refresh OFF
 const bool REFRESH=true;           // Set auto refresh ON
 const bool ON=true;           // Set the Relay ON
 const bool OFF=false;          // Set the Relay OFF
 const bool RELAY_REVERSE=true;          // Set to true for Relay that requires a signal LOW for ON
+const bool FORCE=true;             // Switch the Relay regardless of minimum on/off times, e.g. over-temperature
+const int RELAY_JOURNAL_SIZE=64;       // Number of relay transitions kept for the duty cycle journal
+const int HEATER_POWER=THERMOSTAT_HEATER_POWER; // Heater power in Watts, used to estimate energy use
 const bool SIMULATING=THERMOSTAT_SIMULATING;    // Switch OFF for actual sensor readings, ON for simulated random values
 const int RELAY_PIN=THERMOSTAT_RELAY_PIN;
 const int SENSOR_PIN=THERMOSTAT_SENSOR_PIN;
@@ -49,11 +69,69 @@ const char* SERVER_NAME = "thermostat";                     // Connect to the se
 const char* WIFI_SSID = THERMOSTAT_WIFI_SSID;             // WiFi SSID     replace with details for your local network
 const char* WIFI_PASSWORD = THERMOSTAT_WIFI_PASSWORD;         // WiFi Password replace with details for your local network
 const char* TIMEZONE = THERMOSTAT_TIMEZONE;
-const int NUM_OF_EVENTS=4;              // Number of events per-day, 4 is a practical limit
+const int NUM_OF_EVENTS=SCHEDULE_PERIODS; // Number of events per-day, 4 is a practical limit
+const int MAX_EXCEPTIONS=256;            // Maximum number of holiday/away/set-point calendar entries
+const int CALENDAR_PAGE_ROWS=40;         // Calendar entries per page, about 200 bytes each, keeps /calendar well inside the response buffer
+const String CALENDAR_FILENAME = "exceptions.bin"; // Storage file name on flash for the calendar
+const uint32_t CALENDAR_FILE_MAGIC = 0x31434C43;   // 'CLC1', identifies the calendar file format
+const int STATS_HOURS=24;                // Hourly comfort statistics kept
+const int STATS_DAYS=7;                  // Daily comfort statistics kept
+const int RESPONSE_SLOTS=4;              // Web responses in flight at once, each holds one preallocated buffer
+const int RESPONSE_BUFFER_SIZE=16384;    // Largest page that can be served
+const int WIFI_CONNECT_TIMEOUT=30;       // Seconds start up waits for WiFi, the heating stays under control meanwhile
+const int RETRY_AFTER=2;                 // Seconds a client is asked to wait when the server is busy
+const int LOG_RING_SIZE=64;              // Log records waiting to be written out, must be a power of 2
+const int LOG_HISTORY_SIZE=64;           // Log records kept for the /log page
+const int MAX_SIMULATION_CHANGES=256;    // Set-point changes listed by /simulate, bounded by the response buffer
+const int LOG_LINE_LENGTH=160;           // Longest formatted log line
+const int LOG_DRAIN_INTERVAL=20;         // ms between log task runs
+
+// Log messages, each record holds only the message id and its binary arguments, see log.hpp for the %M conversion
+#define LOG_MESSAGES(X) \
+  X(LOG_STARTING,           "Starting %s") \
+  X(LOG_SENSOR_STARTED,     "Sensor started...") \
+  X(LOG_SENSOR_INIT_FAILED, "Unable to init sensors") \
+  X(LOG_SENSOR_READ_FAILED, "Error in readSample()") \
+  X(LOG_SENSOR_READING,     "Temperature = %.1f, Humidity = %.0f") \
+  X(LOG_RELAY_SWITCHED,     "Thermostat %s") \
+  X(LOG_MDNS_STARTED,       "mDNS responder started, device name: %s") \
+  X(LOG_MDNS_FAILED,        "Error setting up MDNS responder") \
+  X(LOG_WIFI_CONNECTING,    "Connecting to: %s") \
+  X(LOG_WIFI_CONNECTED,     "WiFi connected at: %d.%d.%d.%d") \
+  X(LOG_WIFI_TIMEOUT,       "WiFi not connected after %d s, carrying on and retrying in the background") \
+  X(LOG_SPIFFS_STARTING,    "Starting SPIFFS") \
+  X(LOG_SPIFFS_FORMATTING,  "Formatting SPIFFS (it may take some time)...") \
+  X(LOG_SPIFFS_FAILED,      "SPIFFS failed to start...") \
+  X(LOG_SPIFFS_STARTED,     "SPIFFS Started successfully...") \
+  X(LOG_SETTINGS_SAVING,    "Saving settings...") \
+  X(LOG_SETTINGS_SAVED,     "Settings saved...") \
+  X(LOG_SETTINGS_READING,   "Reading settings...") \
+  X(LOG_SETTINGS_RECOVERED, "Settings recovered...") \
+  X(LOG_SETTINGS_PERIOD,    "Day %d period %d: %.1f from %M to %M") \
+  X(LOG_SETTINGS_VALUES,    "Hysteresis : %.1f, Frost Temp : %d, EarlyStart : %d") \
+  X(LOG_SETTINGS_DWELL,     "Min ON/OFF : %d/%d") \
+  X(LOG_CALENDAR_SAVED,     "Calendar saved, entries : %d") \
+  X(LOG_CALENDAR_RECOVERED, "Calendar recovered, entries : %d") \
+  X(LOG_CALENDAR_REJECTED,  "Calendar entry rejected, invalid, overlapping or calendar full") \
+  X(LOG_TARGET_TEMPERATURE, "Target Temperature = %.1f°") \
+  X(LOG_FROST_PROTECTION,   "Frost protection actuated...") \
+  X(LOG_REQUEST_REJECTED,   "Server busy, priority %d request rejected, %d in flight") \
+  X(LOG_RESPONSE_TOO_LARGE, "Page of %d bytes exceeds the response buffer") \
+  X(LOG_REMOTE_STARTED,     "Remote sensors listening on UDP port %d") \
+  X(LOG_REMOTE_DISABLED,    "Remote sensors disabled, THERMOSTAT_SENSOR_KEY not set or not 32 hex digits") \
+  X(LOG_REMOTE_NODE,        "Remote sensor node %d recorded as sensor %d") \
+  X(LOG_CHECKPOINT_RESTORED,"Warm start %d, restored %d readings, heating %s, manual override %s") \
+  X(LOG_CHECKPOINT_CLEARED, "Cold start, reset reason %d")
+
+#define LOG_MESSAGE_ID(Id, Format) Id,
+#define LOG_MESSAGE_FORMAT(Id, Format) Format,
+enum LogMessage : uint16_t { LOG_MESSAGES(LOG_MESSAGE_ID) LOG_MESSAGE_COUNT };
+const char *const LOG_FORMATS[] = { LOG_MESSAGES(LOG_MESSAGE_FORMAT) };
 
 typedef struct {
   float Temp = 0;
   byte  Humi = 0;
+  byte  Heat = 0;            // Percentage of the reading interval the heater was ON
 } SensorDataType;
 
 struct Settings {
@@ -63,12 +141,25 @@ struct Settings {
   String Temp[NUM_OF_EVENTS];  // Required temperature during the Start-End times
 };
 
+struct SimulationRequest {   // A schedule preview to run, see /simulate
+  WeeklySchedule  Schedule;
+  ControlSettings Settings;
+  ControlState    State;
+  ThermalModel    Model;
+  bool            Replay = false; // Replay the recorded temperature history rather than the thermal model
+  int             Days   = 7;
+};
+
 //################ VARIABLES ################
 SHTSensor sht;
 SensorDataType _sensorData[NUM_OF_SENSORS][MAX_SENSOR_READINGS];
 String _sensorReading[NUM_OF_SENSORS][6];    // 254 Sensors max. and 6 Parameters per sensor T, H, Relay-state. Maximum LoRa adress range is 255 - 1 for Server so 0 - 253
-String _time_str, _doW_str;                 // For Date and Time
+int _dayOfWeek = -1, _minuteOfDay = 0;      // Local day of week (0 = Sun, -1 until the clock is set) and minutes since local midnight
 Settings _timer[7];                        // Timer settings, 7-days of the week
+WeeklySchedule _schedule;                  // Timer settings in minutes, compiled from _timer for the control loop
+SimulationRequest _simulation;             // Filled from the /simulate arguments, then rendered by SimulationJSON
+ExceptionCalendar<MAX_EXCEPTIONS> _calendar; // Date-range exceptions layered over the weekly timer settings
+int _calendarPage = 0;                     // Page of calendar entries to render, from the /calendar request
 int _sensorReadingPointer[NUM_OF_SENSORS];   // Used for sensor data storage
 float  _hysteresis           = 0.2;        // Heating Hysteresis default value
 float  _temperature          = 0;          // Variable for the current temperature
@@ -79,7 +170,11 @@ float  _manOverrideTemp      = 21;         // Manual override temperature
 float  _maxTemperature       = 28;         // Maximum temperature detection, switches off thermostat when reached
 bool   _manualOverride       = false;      // Manual override
 int    _earlyStart           = 0;          // Default thermostat value for early start of heating
-String _relayState           = "OFF";      // Current setting of the control/thermostat relay
+RelayActuator<RELAY_JOURNAL_SIZE> _relay; // Control/thermostat relay state, dwell times and duty cycle journal
+int    _minOnTime            = 0;          // Minimum heating ON time in minutes before the relay may switch OFF
+int    _minOffTime           = 0;          // Minimum heating OFF time in minutes before the relay may switch ON
+uint32_t _heatSampleMs       = 0;          // millis() at the last reading, for the heater duty of each reading
+uint32_t _heatSampleOnMs     = 0;          // Relay on-time at the last reading
 String _timerState           = "OFF";      // Current setting of the timer
 String _units                = "M";        // or Units = "I" for °F and 12:12pm time format
 String _webpage              = "";         // General purpose variable to hold HTML code for display
@@ -89,11 +184,25 @@ int    _lastTimerSwitchCheck = 0;          // Counter for last timer check
 int    _lastReadingCheck     = 0;          // Counter for last reading saved check
 float  _lastTemperature      = 0;          // Last temperature used for rogue reading detection
 int    _unixTime             = 0;          // Time now (when updated) of the current time
+int    _utcOffset            = 0;          // Local time offset from UTC in seconds, including daylight saving
+ComfortStatistics<STATS_HOURS, STATS_DAYS> _stats; // Hourly and daily comfort and energy statistics
+WiFiUDP _sensorUdp;                         // Receives packets from remote sensor nodes
+SensorIngest<REMOTE_SENSORS, REMOTE_REORDER_WINDOW> _ingest; // Authenticates, deduplicates and orders remote sensor packets
+bool   _remoteSensors        = false;      // Remote sensor listener running
+RTC_NOINIT_ATTR Checkpoint<MAX_SENSOR_READINGS> _checkpoint; // Survives a reset (not power loss) for a warm restart
+RTC_NOINIT_ATTR CheckpointImage<decltype(_stats)> _statsCheckpoint; // Statistics and relay accounting alongside it
+RTC_NOINIT_ATTR CheckpointImage<decltype(_relay)> _relayCheckpoint;
+LogRing<LOG_RING_SIZE> _log;               // Log records waiting for the log task
+LogRecord _logHistory[LOG_HISTORY_SIZE];   // Most recent log records for the /log page, oldest overwritten
+int    _logHistoryHead       = 0;
+int    _logHistoryCount      = 0;
+portMUX_TYPE _logHistoryMux  = portMUX_INITIALIZER_UNLOCKED;
 
 // To access server from outside of a WiFi (LAN) network e.g. on port 8080 add a rule on your Router that forwards a connection request
 // to http://your_WAN_address:8080/ to http://your_LAN_address:8080 and then you can view your ESP server from anywhere.
 // Example http://yourhome.ip:8080 and your ESP Server is at 192.168.0.40, then the request will be directed to http://192.168.0.40:8080
 AsyncWebServer server(THERMOSTAT_SERVER_PORT); // Server on IP address port 80 (web-browser default, change to your requirements, e.g. 8080
+ResponsePool<RESPONSE_SLOTS, RESPONSE_BUFFER_SIZE> _responses; // Preallocated response buffers, bounds concurrent page renders
 
 //#########################################
 //################ SENSORS ################
@@ -104,9 +213,9 @@ void startSensor() {
       delay(1000); // let serial console settle
 
        if (sht.init()) {
-            Serial.print("Sensor started...\n");
+            LOG_INFO(LOG_SENSOR_STARTED);
         } else {
-            Serial.print("Unable to init sensors\n");
+            LOG_ERROR(LOG_SENSOR_INIT_FAILED);
         }
         sht.setAccuracy(SHTSensor::SHT_ACCURACY_MEDIUM); // only supported by SHT3x
   }
@@ -128,140 +237,230 @@ void readSensor() {
          }
         _lastTemperature = _temperature;
     } else {
-        Serial.print("Error in readSample()\n");
+        LOG_WARN(LOG_SENSOR_READ_FAILED);
     }
   }
-  Serial.println("Temperature = " + String(_temperature, 1) + ", Humidity = " + String(_humidity, 0));
+  LOG_DEBUG(LOG_SENSOR_READING, _temperature, _humidity);
 }
 
-void switchRelay(bool demand) {
-  pinMode(RELAY_PIN, OUTPUT);
-
+void writeRelayPin(bool demand) {
   if (demand) {
-    _relayState = "ON";
-    if (RELAY_REVERSE) {
-      digitalWrite(RELAY_PIN, LOW);
-    }
-    else
-    {
-      digitalWrite(RELAY_PIN, HIGH);
-    }
-    Serial.println("Thermostat ON");
+    digitalWrite(RELAY_PIN, RELAY_REVERSE ? LOW : HIGH);
   }
   else
   {
-    _relayState = "OFF";
-    if (RELAY_REVERSE) {
-      digitalWrite(RELAY_PIN, HIGH);
-    }
-    else
-    {
-      digitalWrite(RELAY_PIN, LOW);
-    }
-    Serial.println("Thermostat OFF");
+    digitalWrite(RELAY_PIN, RELAY_REVERSE ? HIGH : LOW);
   }
 }
 
-void controlHeating() {
-  if (_temperature < (_targetTemp - _hysteresis)) {           // Check if room temeperature is below set-point and hysteresis offset
-    switchRelay(ON);                                    // Switch Relay/Heating ON if so
-  }
-  if (_temperature > (_targetTemp + _hysteresis)) {           // Check if room temeperature is above set-point and hysteresis offset
-    switchRelay(OFF);                                   // Switch Relay/Heating OFF if so
+void startRelay(bool demand) {
+  pinMode(RELAY_PIN, OUTPUT);
+  _relay.begin(demand, millis());
+  writeRelayPin(demand);                                 // Drive the output once so hardware and state agree
+}
+
+void switchRelay(bool demand, bool force = false) {
+  if (!_relay.request(demand, millis(), _unixTime, force)) return; // No change, or held by the minimum on/off time
+  writeRelayPin(demand);
+  LOG_INFO(LOG_RELAY_SWITCHED, demand ? "ON" : "OFF");
+}
+
+String relayStateString() {
+  return _relay.isOn() ? "ON" : "OFF";
+}
+
+void addReadingsToSensorData(byte RxdFromID, const SensorDataType *Readings, int Count) {
+  int ptr = _sensorReadingPointer[RxdFromID];
+  if (Count > MAX_SENSOR_READINGS) {                         // Only the most recent readings fit
+    Readings += Count - MAX_SENSOR_READINGS;
+    Count = MAX_SENSOR_READINGS;
   }
-  if (_temperature > _maxTemperature) {                      // Check for faults/over-temperature
-    switchRelay(OFF);                                   // Switch Relay/Heating OFF if temperature is above maximum temperature
+  int Overflow = ptr + Count - MAX_SENSOR_READINGS;
+  if (Overflow > 0) {                                       // Full, so shift the history once for the whole batch
+    memmove(_sensorData[RxdFromID], _sensorData[RxdFromID] + Overflow, (MAX_SENSOR_READINGS - Overflow) * sizeof(SensorDataType));
+    ptr -= Overflow;
   }
+  memcpy(_sensorData[RxdFromID] + ptr, Readings, Count * sizeof(SensorDataType));
+  _sensorReadingPointer[RxdFromID] = ptr + Count;
 }
 
-void addReadingToSensorData(byte RxdFromID, float Temperature, byte Humidity) {
-  byte ptr, p;
-  ptr = _sensorReadingPointer[RxdFromID];
-  _sensorData[RxdFromID][ptr].Temp = Temperature;
-  _sensorData[RxdFromID][ptr].Humi = Humidity;
-  ptr++;
-  if (ptr >= MAX_SENSOR_READINGS) {
-    p = 0;
-    do {
-      _sensorData[RxdFromID][p].Temp  = _sensorData[RxdFromID][p + 1].Temp;
-      _sensorData[RxdFromID][p].Humi  = _sensorData[RxdFromID][p + 1].Humi;
-      p++;
-    } while (p < MAX_SENSOR_READINGS);
-    ptr = MAX_SENSOR_READINGS - 1;
-    _sensorData[RxdFromID][MAX_SENSOR_READINGS - 1].Temp = Temperature;
-    _sensorData[RxdFromID][MAX_SENSOR_READINGS - 1].Humi = Humidity;
-  }
-  _sensorReadingPointer[RxdFromID] = ptr;
+void addReadingToSensorData(byte RxdFromID, float Temperature, byte Humidity, byte Heat = 0) {
+  SensorDataType Reading;
+  Reading.Temp = Temperature;
+  Reading.Humi = Humidity;
+  Reading.Heat = Heat;
+  addReadingsToSensorData(RxdFromID, &Reading, 1);
+}
+
+byte heaterDutySinceLastReading() {
+  uint32_t Now     = millis();
+  uint32_t OnMs    = _relay.onMs(Now);
+  uint32_t Elapsed = Now - _heatSampleMs;
+  uint32_t Duty    = Elapsed > 0 ? (uint64_t)(OnMs - _heatSampleOnMs) * 100 / Elapsed : 0;
+  _heatSampleMs    = Now;
+  _heatSampleOnMs  = OnMs;
+  return Duty > 100 ? 100 : Duty;
+}
+
+float comfortTarget() {
+  if (_timerState == "ON" || _manualOverride == ON) return _targetTemp; // Heating is scheduled, so measure against the set-point
+  return _frostTemp;                                                    // Otherwise only frost protection is demanded
 }
 
 void assignMaxSensorReadingsToArray() {
+  byte Heat = heaterDutySinceLastReading();
   _sensorReading[1][0] = 1;
   _sensorReading[1][1] = _temperature;
   _sensorReading[1][2] = _humidity;
-  _sensorReading[1][3] = _relayState;
-  addReadingToSensorData(1, _temperature, _humidity); // Only sensor-1 is implemented here, could  be more though
+  _sensorReading[1][3] = relayStateString();
+  addReadingToSensorData(1, _temperature, _humidity, Heat); // Only sensor-1 is implemented here, could  be more though
+  _checkpoint.addSample(_temperature, _humidity, Heat);     // Mirror the local history for a warm restart
+  if (_unixTime > 0) {                                      // Statistics are kept by local hour and day, so need the time
+    int Seconds = _lastReadingDuration * 60;
+    _stats.add(_unixTime + _utcOffset, Seconds, _temperature, _humidity, comfortTarget(), _hysteresis, Seconds * Heat / 100);
+    _statsCheckpoint.save(_stats);
+  }
 }
 
 
+void addRemoteReadings(size_t Slot, const SensorNodeStats &Node, const SensorReading *Readings, size_t Count) {
+  SensorDataType Batch[SENSOR_PACKET_BATCH];
+  byte Channel = REMOTE_SENSOR_CHANNEL + Slot;
+  for (size_t r = 0; r < Count; r++) {
+    Batch[r].Temp = Readings[r].Temp;
+    Batch[r].Humi = Readings[r].Humi;
+  }
+  if (Node.Readings == Count) LOG_INFO(LOG_REMOTE_NODE, Node.Node, Channel); // First batch from this node
+  addReadingsToSensorData(Channel, Batch, Count);
+  _sensorReading[Channel][0] = Node.Node;
+  _sensorReading[Channel][1] = Node.Last.Temp;
+  _sensorReading[Channel][2] = Node.Last.Humi;
+  _sensorReading[Channel][4] = Node.Last.Battery;
+}
+
+void startRemoteSensors() {
+  uint8_t Key[16];
+#ifdef THERMOSTAT_SENSOR_KEY
+  _remoteSensors = parseSensorKey(THERMOSTAT_SENSOR_KEY, Key);
+#endif
+  if (!_remoteSensors) {
+    LOG_WARN(LOG_REMOTE_DISABLED);
+    return;
+  }
+  _ingest.begin(Key, addRemoteReadings, REMOTE_REORDER_TIMEOUT);
+  _sensorUdp.begin(THERMOSTAT_SENSOR_PORT);
+  LOG_INFO(LOG_REMOTE_STARTED, THERMOSTAT_SENSOR_PORT);
+}
+
+void readRemoteSensors() {
+  uint8_t Packet[SENSOR_PACKET_MAX + 1];                    // One spare byte so that oversized packets are seen as malformed
+  int Length;
+  for (int n = 0; n < REMOTE_PACKETS_PER_LOOP && (Length = _sensorUdp.parsePacket()) > 0; n++) {
+    _ingest.receive(Packet, _sensorUdp.read(Packet, sizeof(Packet)), millis());
+  }
+  _ingest.expire(millis());
+}
+
 //#########################################
 //################ SYSTEM #################
 //#########################################
+size_t formatLogLine(const LogRecord &Record, char *Line, size_t Size) {
+  int Length = snprintf(Line, Size, "%lu.%03lu %-5s ", (unsigned long)(Record.Ms / 1000), (unsigned long)(Record.Ms % 1000), logLevelName(Record.Level));
+  return Length + formatLogRecord(Record, Record.Id < LOG_MESSAGE_COUNT ? LOG_FORMATS[Record.Id] : "?", Line + Length, Size - Length);
+}
+
+void logTask(void *parameter) {
+  LogRecord Record;
+  char Line[LOG_LINE_LENGTH];
+  for (;;) {
+    while (_log.pop(Record)) {                                  // Formatting and the slow UART writes happen here, off the control loop
+      formatLogLine(Record, Line, sizeof(Line));
+      Serial.println(Line);
+      portENTER_CRITICAL(&_logHistoryMux);
+      _logHistory[_logHistoryHead] = Record;
+      _logHistoryHead = (_logHistoryHead + 1) % LOG_HISTORY_SIZE;
+      if (_logHistoryCount < LOG_HISTORY_SIZE) _logHistoryCount++;
+      portEXIT_CRITICAL(&_logHistoryMux);
+    }
+    vTaskDelay(LOG_DRAIN_INTERVAL / portTICK_PERIOD_MS);
+  }
+}
+
 void setupSystem() {
   Serial.begin(9600);                                           // Initialise serial communications
   delay(200);
-  Serial.println(__FILE__);
-  Serial.println("Starting...");
+  xTaskCreatePinnedToCore(logTask, "log", 4096, NULL, 1, NULL, 0); // Low priority, on the core not running loop()
+  LOG_INFO(LOG_STARTING, __FILE__);
 }
 
 void setupDeviceName(const char *DeviceName) {
   if (MDNS.begin(DeviceName)) { // The name that will identify your device on the network
-    Serial.println("mDNS responder started");
-    Serial.print("Device name: ");
-    Serial.println(DeviceName);
+    LOG_INFO(LOG_MDNS_STARTED, DeviceName);
     MDNS.addService("n8i-mlp", "tcp", 23); // Add service
   }
   else
-    Serial.println("Error setting up MDNS responder");
+    LOG_ERROR(LOG_MDNS_FAILED);
 }
 
+void waitUnderControl(uint32_t ms);       // Defined with the control code below
+
 void startWiFi() {
-  Serial.print("\r\nConnecting to: "); Serial.println(String(WIFI_SSID));
+  LOG_INFO(LOG_WIFI_CONNECTING, WIFI_SSID);
   IPAddress dns(8, 8, 8, 8); // Use Google as DNS
   WiFi.disconnect();
   WiFi.mode(WIFI_STA);       // switch off AP
   WiFi.setAutoConnect(true);
   WiFi.setAutoReconnect(true);
   WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+  uint32_t Started = millis();
   while (WiFi.status() != WL_CONNECTED) {
-    Serial.print(".");
-    delay(50);
+    if (millis() - Started > WIFI_CONNECT_TIMEOUT * 1000) { // Auto reconnect keeps trying while loop() runs the heating
+      LOG_WARN(LOG_WIFI_TIMEOUT, WIFI_CONNECT_TIMEOUT);
+      return;
+    }
+    waitUnderControl(50);
   }
-  Serial.println("\nWiFi connected at: " + WiFi.localIP().toString());
+  IPAddress IP = WiFi.localIP();
+  LOG_INFO(LOG_WIFI_CONNECTED, IP[0], IP[1], IP[2], IP[3]);
+}
+
+int utcOffset(time_t now) {
+  struct tm local_tm = *localtime(&now);
+  struct tm utc_tm   = *gmtime(&now);
+  int Days = local_tm.tm_yday - utc_tm.tm_yday;
+  if (local_tm.tm_year != utc_tm.tm_year) Days = (local_tm.tm_year > utc_tm.tm_year) ? 1 : -1; // Either side of new year
+  return Days * 86400 + (local_tm.tm_hour - utc_tm.tm_hour) * 3600 + (local_tm.tm_min - utc_tm.tm_min) * 60;
 }
 
-boolean updateLocalTime() {
+boolean updateLocalTime(uint32_t waitMs = 15000) {
   struct tm timeinfo;
   time_t now;
-  char  time_output[30];
-  while (!getLocalTime(&timeinfo, 15000)) {                        // Wait for up to 15-sec for time to synchronise
+  while (!getLocalTime(&timeinfo, waitMs)) {                       // Wait for up to 15-sec for time to synchronise
     return false;
   }
   time(&now);
   _unixTime = now;
-  //See http://www.cplusplus.com/reference/ctime/strftime/
-  strftime(time_output, sizeof(time_output), "%H:%M", &timeinfo);  // Creates: '14:05'
-  _time_str = time_output;
-  strftime(time_output, sizeof(time_output), "%w", &timeinfo);     // Creates: '0' for Sun
-  _doW_str  = time_output;
+  _utcOffset = utcOffset(now);
+  _relay.setUtcOffset(_utcOffset);                                 // Duty cycle days run from local midnight
+  _dayOfWeek   = timeinfo.tm_wday;                                   // 0 for Sun
+  _minuteOfDay = timeinfo.tm_hour * 60 + timeinfo.tm_min;             // 14:05 is 845
   return true;
 }
 
-boolean setupTime() {
-  configTime(0, 0, "time.nist.gov");                               // (gmtOffset_sec, daylightOffset_sec, ntpServer)
+void setTimeZone() {
   setenv("TZ", TIMEZONE, 1);                                       // setenv()adds "TZ" variable to the environment, only used if set to 1, 0 means no change
   tzset();
-  delay(200);
-  bool TimeStatus = updateLocalTime();
+}
+
+boolean setupTime() {
+  configTime(0, 0, "time.nist.gov");                               // (gmtOffset_sec, daylightOffset_sec, ntpServer)
+  setTimeZone();                                                   // configTime() resets it to UTC
+  uint32_t Started = millis();
+  bool TimeStatus = updateLocalTime(0);
+  while (!TimeStatus && millis() - Started < 15000) {              // Wait for up to 15-sec for time to synchronise, still controlling the heating
+    waitUnderControl(200);
+    TimeStatus = updateLocalTime(0);
+  }
   return TimeStatus;
 }
 
@@ -273,22 +472,42 @@ String convertUnixTime(int unix_time) {
   return output;
 }
 
+String convertUnixDate(int unix_time) {
+  time_t tm = unix_time;
+  struct tm *now_tm = localtime(&tm);
+  char output[40];
+  strftime(output, sizeof(output), (_units == "M" ? "%d/%m/%Y %H:%M" : "%m/%d/%Y %H:%M"), now_tm); // Returns 24/12/2022 21:12
+  return output;
+}
+
+int parseDateTime(String date_time) {
+  struct tm tm_input = {};
+  if (sscanf(date_time.c_str(), "%d-%d-%dT%d:%d", &tm_input.tm_year, &tm_input.tm_mon, &tm_input.tm_mday, &tm_input.tm_hour, &tm_input.tm_min) != 5) {
+    return 0;                                                      // Expects the HTML datetime-local format '2022-12-24T21:12'
+  }
+  tm_input.tm_year -= 1900;
+  tm_input.tm_mon  -= 1;
+  tm_input.tm_isdst = -1;                                          // Let the timezone rules decide on daylight saving
+  time_t parsed = mktime(&tm_input);
+  return parsed > 0 ? parsed : 0;                                  // 0 is never a valid calendar time
+}
+
 void startSPIFFS() {
-  Serial.println("Starting SPIFFS");
+  LOG_INFO(LOG_SPIFFS_STARTING);
   boolean SPIFFS_Status;
   SPIFFS_Status = SPIFFS.begin();
   if (SPIFFS_Status == false)
   { // Most likely SPIFFS has not yet been formated, so do so
-    Serial.println("Formatting SPIFFS (it may take some time)...");
+    LOG_WARN(LOG_SPIFFS_FORMATTING);
     SPIFFS.begin(true); // Now format SPIFFS
     File datafile = SPIFFS.open("/" + SETTINGS_FILENAME, "r");
     if (!datafile || !datafile.isDirectory()) {
-      Serial.println("SPIFFS failed to start..."); // Nothing more can be done, so delete and then create another file
+      LOG_ERROR(LOG_SPIFFS_FAILED); // Nothing more can be done, so delete and then create another file
       SPIFFS.remove("/" + SETTINGS_FILENAME); // The file is corrupted!!
       datafile.close();
     }
   }
-  else Serial.println("SPIFFS Started successfully...");
+  else LOG_INFO(LOG_SPIFFS_STARTED);
 }
 
 String getWiFiSignal() {
@@ -305,138 +524,212 @@ void initialise_Array() {
   _timer[0].DoW = "Sun"; _timer[1].DoW = "Mon"; _timer[2].DoW = "Tue"; _timer[3].DoW = "Wed"; _timer[4].DoW = "Thu"; _timer[5].DoW = "Fri"; _timer[6].DoW = "Sat";
 }
 
+// Converts the timer settings to minutes once, rather than comparing time strings on every control pass
+void compileSchedule(const Settings *Timer, WeeklySchedule &Schedule) {
+  for (byte dow = 0; dow < 7; dow++) {
+    for (byte p = 0; p < NUM_OF_EVENTS; p++) {
+      Schedule.Days[dow][p].Start = parseClock(Timer[dow].Start[p].c_str()); // '06:30' is 390, blank is -1 (unused)
+      Schedule.Days[dow][p].Stop  = parseClock(Timer[dow].Stop[p].c_str());
+      Schedule.Days[dow][p].Temp  = Timer[dow].Temp[p].toFloat();
+    }
+  }
+}
+
 void saveSettingsPage() {
-  Serial.println("Getting ready to Save settings...");
   File dataFile = SPIFFS.open("/" + SETTINGS_FILENAME, "w");
   if (dataFile) { // Save settings
-    Serial.println("Saving settings...");
+    LOG_INFO(LOG_SETTINGS_SAVING);
     for (byte dow = 0; dow < 7; dow++) {
-      Serial.println("Day of week = " + String(dow));
       for (byte p = 0; p < NUM_OF_EVENTS; p++) {
         dataFile.println(_timer[dow].Temp[p]);
         dataFile.println(_timer[dow].Start[p]);
         dataFile.println(_timer[dow].Stop[p]);
-        Serial.println("Period: " + String(p) + " " + _timer[dow].Temp[p] + " from: " + _timer[dow].Start[p] + " to: " + _timer[dow].Stop[p]);
+        LOG_DEBUG(LOG_SETTINGS_PERIOD, dow, p, _timer[dow].Temp[p].toFloat(), parseClock(_timer[dow].Start[p].c_str()), parseClock(_timer[dow].Stop[p].c_str()));
       }
     }
     dataFile.println(_hysteresis, 1);
     dataFile.println(_frostTemp, 1);
     dataFile.println(_earlyStart);
-    Serial.println("Saved Hysteresis : " + String(_hysteresis));
-    Serial.println("Saved Frost Temp : " + String(_frostTemp));
-    Serial.println("Saved EarlyStart : " + String(_earlyStart));
+    dataFile.println(_minOnTime);
+    dataFile.println(_minOffTime);
+    LOG_INFO(LOG_SETTINGS_VALUES, _hysteresis, _frostTemp, _earlyStart);
+    LOG_INFO(LOG_SETTINGS_DWELL, _minOnTime, _minOffTime);
     dataFile.close();
-    Serial.println("Settings saved...");
+    LOG_INFO(LOG_SETTINGS_SAVED);
   }
 }
 
 void recoverSettings() {
   String Entry;
-  Serial.println("Reading settings...");
+  LOG_INFO(LOG_SETTINGS_READING);
   File dataFile = SPIFFS.open("/" + SETTINGS_FILENAME, "r");
   if (dataFile) { // if the file is available, read it
-    Serial.println("Recovering settings...");
     while (dataFile.available()) {
       for (byte dow = 0; dow < 7; dow++) {
-        Serial.println("Day of week = " + String(dow));
         for (byte p = 0; p < NUM_OF_EVENTS; p++) {
           _timer[dow].Temp[p]  = dataFile.readStringUntil('\n'); _timer[dow].Temp[p].trim();
           _timer[dow].Start[p] = dataFile.readStringUntil('\n'); _timer[dow].Start[p].trim();
           _timer[dow].Stop[p]  = dataFile.readStringUntil('\n'); _timer[dow].Stop[p].trim();
-          Serial.println("Period: " + String(p) + " " + _timer[dow].Temp[p] + " from: " + _timer[dow].Start[p] + " to: " + _timer[dow].Stop[p]);
+          LOG_DEBUG(LOG_SETTINGS_PERIOD, dow, p, _timer[dow].Temp[p].toFloat(), parseClock(_timer[dow].Start[p].c_str()), parseClock(_timer[dow].Stop[p].c_str()));
         }
       }
       Entry = dataFile.readStringUntil('\n'); Entry.trim(); _hysteresis = Entry.toFloat();
       Entry = dataFile.readStringUntil('\n'); Entry.trim(); _frostTemp  = Entry.toInt();
       Entry = dataFile.readStringUntil('\n'); Entry.trim(); _earlyStart = Entry.toInt();
-      Serial.println("Recovered Hysteresis : " + String(_hysteresis));
-      Serial.println("Recovered Frost Temp : " + String(_frostTemp));
-      Serial.println("Recovered EarlyStart : " + String(_earlyStart));
+      Entry = dataFile.readStringUntil('\n'); Entry.trim(); _minOnTime  = constrain(Entry.toInt(), 0, 99); // Absent in older files, so 0 (no minimum)
+      Entry = dataFile.readStringUntil('\n'); Entry.trim(); _minOffTime = constrain(Entry.toInt(), 0, 99);
+      LOG_INFO(LOG_SETTINGS_VALUES, _hysteresis, _frostTemp, _earlyStart);
+      LOG_INFO(LOG_SETTINGS_DWELL, _minOnTime, _minOffTime);
       dataFile.close();
-      Serial.println("Settings recovered...");
+      LOG_INFO(LOG_SETTINGS_RECOVERED);
     }
   }
+  compileSchedule(_timer, _schedule);
 }
 
-//#########################################
-//################ SCHEDULING #############
-//#########################################
-void updateTargetTemperature() {
-  String TimeNow;
-  TimeNow = convertUnixTime(_unixTime);
-  for (byte dow = 0; dow < 7; dow++) {
-    for (byte p = 0; p < NUM_OF_EVENTS; p++) {
-      if (String(dow) == _doW_str && (TimeNow >= _timer[dow].Start[p] && TimeNow < _timer[dow].Stop[p]))
-      {
-        _targetTemp = _timer[dow].Temp[p].toFloat();               // Found the programmed set-point temperature from the scheduled time period
-      }
-    }
+void saveCalendar() {
+  if (_unixTime > 0) _calendar.prune(_unixTime);   // Finished entries are of no further use
+  File dataFile = SPIFFS.open("/" + CALENDAR_FILENAME, "w");
+  if (dataFile) {
+    uint32_t Count = _calendar.size();
+    dataFile.write((const uint8_t *)&CALENDAR_FILE_MAGIC, sizeof(CALENDAR_FILE_MAGIC));
+    dataFile.write((const uint8_t *)&Count, sizeof(Count));
+    dataFile.write((const uint8_t *)_calendar.data(), Count * sizeof(CalendarException));
+    dataFile.close();
+    LOG_INFO(LOG_CALENDAR_SAVED, Count);
   }
-  if (_manualOverride == ON) _targetTemp = _manOverrideTemp;
-  Serial.println("Target Temperature = " + String(_targetTemp, 1) + "°");
 }
 
-void checkAndSetFrostTemperature() {
-  if (_timerState == "OFF" && _manualOverride == OFF) { // Only check for frost protection when heating is off
-    if (_temperature < (_frostTemp - _hysteresis)) {     // Check if temperature is below Frost Protection temperature and hysteresis offset
-      switchRelay(ON);                             // Switch Relay/Heating ON if so
-      Serial.println("Frost protection actuated...");
-    }
-    if (_temperature > (_frostTemp + _hysteresis)) {     // Check if temerature is above Frost Protection temperature and hysteresis offset
-      switchRelay(OFF);                            // Switch Relay/Heating OFF if so
+void recoverCalendar() {
+  File dataFile = SPIFFS.open("/" + CALENDAR_FILENAME, "r");
+  if (dataFile) {
+    uint32_t Magic = 0, Count = 0;
+    dataFile.read((uint8_t *)&Magic, sizeof(Magic));
+    dataFile.read((uint8_t *)&Count, sizeof(Count));
+    if (Magic == CALENDAR_FILE_MAGIC && Count <= MAX_EXCEPTIONS) {
+      static CalendarException Entries[MAX_EXCEPTIONS];  // Static to keep a 4K buffer off the task stack
+      size_t Bytes = dataFile.read((uint8_t *)Entries, Count * sizeof(CalendarException));
+      _calendar.load(Entries, Bytes / sizeof(CalendarException));
     }
+    dataFile.close();
+    LOG_INFO(LOG_CALENDAR_RECOVERED, _calendar.size());
   }
 }
 
+//#########################################
+//################ CHECKPOINT #############
+//#########################################
+void updateCheckpoint() {
+  if (_unixTime > 0) _checkpoint.Epoch = _unixTime;
+  _checkpoint.LastTemperature = _lastTemperature;
+  _checkpoint.TargetTemp      = _targetTemp;
+  _checkpoint.ManOverrideTemp = _manOverrideTemp;
+  _checkpoint.RelayOn         = _relay.isOn();
+  _checkpoint.ManualOverride  = _manualOverride;
+  _checkpoint.TimerOn         = _timerState == "ON";
+  _checkpoint.seal();                                        // Header only, the history CRC is kept by addSample()
+  _relayCheckpoint.save(_relay);                             // Duty buckets, journal and counters
+}
 
-void CheckTimerEvent() {
-  String TimeNow;
-  updateTargetTemperature();
-  TimeNow    = convertUnixTime(_unixTime);                  // Get the current time e.g. 15:35
-  _timerState = "OFF";                                      // Switch timer off until decided by the schedule
-  if (_earlyStart > 0) {                                    // If early start is enabled by a value > 0
-    TimeNow = convertUnixTime(_unixTime + _earlyStart * 60); // Advance the clock by the Early Start Duration
+bool restoreCheckpoint() {
+  esp_reset_reason_t Reason = esp_reset_reason();
+  if (Reason == ESP_RST_POWERON || !_checkpoint.valid()) {   // RTC memory does not survive a power cycle
+    _checkpoint.reset();
+    _statsCheckpoint.clear();
+    _relayCheckpoint.clear();
+    LOG_INFO(LOG_CHECKPOINT_CLEARED, (int)Reason);
+    return false;
   }
-  if (_manualOverride == ON) {                              // If manual override is enabled then turn the heating on
-    _targetTemp = _manOverrideTemp;                          // Set the target temperature to the manual overide temperature
-    controlHeating();                                      // Control the heating as normal
+  if (time(NULL) < (time_t)_checkpoint.Epoch) {              // Clock lost in the reset, resume from the last known time until NTP syncs
+    struct timeval Now = { (time_t)_checkpoint.Epoch, 0 };
+    settimeofday(&Now, NULL);
   }
-  else
-  {
-    for (byte dow = 0; dow < 7; dow++) {                     // Look for any valid timer events, if found turn the heating on
-      for (byte p = 0; p < NUM_OF_EVENTS; p++) {
-        // Now check for a scheduled ON time, if so Switch the Timer ON and check the temperature against target temperature
-        if (String(dow) == _doW_str && (TimeNow >= _timer[dow].Start[p] && TimeNow <= _timer[dow].Stop[p] && _timer[dow].Start[p] != ""))
-        {
-          _timerState = "ON";
-          controlHeating();
-          _manualOverride = OFF; // If it was ON turn it OFF when the timer starts a controlled period
-        }
-      }
-    }
+  _lastTemperature = _checkpoint.LastTemperature;
+  _targetTemp      = _checkpoint.TargetTemp;
+  _manOverrideTemp = _checkpoint.ManOverrideTemp;
+  _manualOverride  = _checkpoint.ManualOverride;
+  _timerState      = _checkpoint.TimerOn ? "ON" : "OFF";
+  _statsCheckpoint.restore(_stats);                          // No gap in /stats or the duty cycle table
+  _relayCheckpoint.restore(_relay);                          // Before startRelay(), which restarts its millis() timing
+  startRelay(_checkpoint.RelayOn && _checkpoint.Epoch > 0);  // Keep the heating as it was, no OFF/ON glitch, unless there is no clock to control it by
+  for (int r = 0; r < _checkpoint.HistoryCount; r++) {
+    const CheckpointSample &Sample = _checkpoint.sample(r);
+    _sensorData[1][r].Temp = Sample.Temp / 100.0;
+    _sensorData[1][r].Humi = Sample.Humi;
+    _sensorData[1][r].Heat = Sample.Heat;
+  }
+  for (int r = _checkpoint.HistoryCount; r < MAX_SENSOR_READINGS && _checkpoint.HistoryCount > 0; r++) {
+    _sensorData[1][r] = _sensorData[1][_checkpoint.HistoryCount - 1]; // Pad with the latest reading, setup() fills an empty history
   }
-  checkAndSetFrostTemperature();
+  _sensorReadingPointer[1] = _checkpoint.HistoryCount;
+  _checkpoint.WarmStarts++;
+  _checkpoint.seal();
+  LOG_INFO(LOG_CHECKPOINT_RESTORED, _checkpoint.WarmStarts, _checkpoint.HistoryCount, _checkpoint.RelayOn ? "ON" : "OFF", _checkpoint.ManualOverride ? "ON" : "OFF");
+  return true;
 }
 
+//#########################################
+//################ SCHEDULING #############
+//#########################################
+ControlSettings controlSettings() {
+  ControlSettings Settings;
+  Settings.Hysteresis      = _hysteresis;
+  Settings.FrostTemp       = _frostTemp;
+  Settings.EarlyStart      = _earlyStart;
+  Settings.ManOverrideTemp = _manOverrideTemp;
+  Settings.MaxTemperature  = _maxTemperature;
+  Settings.MinOnTime       = _minOnTime;
+  Settings.MinOffTime      = _minOffTime;
+  return Settings;
+}
+
+void CheckTimerEvent() {
+  ControlState State;
+  State.TargetTemp     = _targetTemp;
+  State.ManualOverride = _manualOverride;
+  const CalendarException *Exception = _calendar.find(_unixTime); // Binary search of the calendar for an entry covering now
+  const CalendarException *Upcoming  = _calendar.find(_unixTime + _earlyStart * 60); // and one due by the end of the early start time
+  ControlResult Result = evaluateControl(_schedule, controlSettings(), State, _dayOfWeek, _minuteOfDay, Exception, Upcoming, _temperature);
+  _targetTemp     = State.TargetTemp;
+  _manualOverride = State.ManualOverride;
+  _timerState     = Result.TimerOn ? "ON" : "OFF";
+  LOG_DEBUG(LOG_TARGET_TEMPERATURE, _targetTemp);
+  if (Result.Demand != DEMAND_NONE) switchRelay(Result.Demand == DEMAND_ON, Result.Force);
+  if (Result.Frost) LOG_INFO(LOG_FROST_PROTECTION);
+  _relay.update(millis(), _unixTime);                       // Keep the duty cycle accounting current
+  updateCheckpoint();
+}
+
+// Start up waits on WiFi and NTP through this, so that a relay restored ON after a reset stays under control meanwhile
+void waitUnderControl(uint32_t ms) {
+  delay(ms);
+  if ((millis() - _lastTimerSwitchCheck) > (uint32_t)_timerCheckDuration) {
+    _lastTimerSwitchCheck = millis();
+    readSensor();
+    updateLocalTime(0);                                     // Never blocks, the restored clock runs on until NTP syncs
+    CheckTimerEvent();
+  }
+}
 
 //#########################################
 //################ PAGES ##################
 //#########################################
-String preLoadChartData(byte Channel, String Type) {
+// Appends straight to _webpage, piece by piece, so a graph refresh builds no temporary strings on the heap
+void add_ChartData(byte Channel, const String &Type) {
+  char Row[48];
   byte r = 0;
-  String Data = "";
   do {
     if (Type == "Temperature") {
-      Data += "[" + String(r) + "," + String(_sensorData[Channel][r].Temp, 1) + "," + String(_targetTemp, 1) + "],";
+      snprintf(Row, sizeof(Row), "[%d,%.1f,%.1f,%d],", r, _sensorData[Channel][r].Temp, _targetTemp, (int)_sensorData[Channel][r].Heat);
     }
     else
     {
-      Data += "[" + String(r) + "," + String(_sensorData[Channel][r].Humi) + "],";
+      snprintf(Row, sizeof(Row), "[%d,%d],", r, (int)_sensorData[Channel][r].Humi);
     }
+    _webpage += Row;
     r++;
   } while (r < MAX_SENSOR_READINGS);
-  Data += "]";
-  return Data;
+  _webpage += "]";
 }
 
 void append_HTML_header(bool refreshMode) {
@@ -478,12 +771,12 @@ void append_HTML_header(bool refreshMode) {
   _webpage += "<a href='/'>Status</a>";
   _webpage += "<a href='graphs'>Graph</a>";
   _webpage += "<a href='timer'>Schedule</a>";
+  _webpage += "<a href='calendar'>Calendar</a>";
   _webpage += "<a href='setup'>Setup</a>";
+  _webpage += "<a href='stats'>Stats</a>";
   _webpage += "<a href='help'>Help</a>";
   _webpage += "<a href=''></a>";
   _webpage += "<a href=''></a>";
-  _webpage += "<a href=''></a>";
-  _webpage += "<a href=''></a>";
   _webpage += "<div class='wifi'/></div><span>" + getWiFiSignal() + "</span>";
   _webpage += "</div><br>";
 }
@@ -495,41 +788,95 @@ void append_HTML_footer() {
   _webpage += "</body></html>";
 }
 
-void add_Graph(byte Channel, String Type, String Title, String GraphType, String Units, String Colour, String Div) {
-  String Data = preLoadChartData(Channel, Title);
-  _webpage += "function draw" + Type + String(Channel) + "() {";
+void add_Graph(byte Channel, const String &Type, const String &Title, const String &GraphType, const String &Units, const String &Colour, const String &Div) {
+  _webpage += "function draw"; _webpage += Type; _webpage += Channel; _webpage += "() {";
   if (Type == "GraphT") {
-    _webpage += " var data = google.visualization.arrayToDataTable(" + String("[['Hour', 'Rm T°', 'Tgt T°'],") + Data + ");";
+    _webpage += " var data = google.visualization.arrayToDataTable([['Hour', 'Rm T°', 'Tgt T°', 'Heat %'],";
   }
   else
-    _webpage += " var data = google.visualization.arrayToDataTable(" + String("[['Hour', 'RH %'],") + Data + ");";
+    _webpage += " var data = google.visualization.arrayToDataTable([['Hour', 'RH %'],";
+  add_ChartData(Channel, Title);
+  _webpage += ");";
   _webpage += " var options = {";
-  _webpage += "  title: '" + Title + "',";
+  _webpage += "  title: '"; _webpage += Title; _webpage += "',";
   _webpage += "  titleFontSize: 14,";
-  _webpage += "  backgroundColor: '" + BACKGROUND_COLOR + "',";
-  _webpage += "  legendTextStyle: { color: '" + LEGEND_COLOR + "' },";
-  _webpage += "  titleTextStyle:  { color: '" + TITLE_COLOR  + "' },";
+  _webpage += "  backgroundColor: '"; _webpage += BACKGROUND_COLOR; _webpage += "',";
+  _webpage += "  legendTextStyle: { color: '"; _webpage += LEGEND_COLOR; _webpage += "' },";
+  _webpage += "  titleTextStyle:  { color: '"; _webpage += TITLE_COLOR;  _webpage += "' },";
   _webpage += "  hAxis: {color: '#FFF'},";
-  _webpage += "  vAxis: {color: '#FFF', title: '" + Units + "'},";
+  if (Type == "GraphT") {                                    // Heater ON bands drawn as a stepped area on a 0-100% second axis
+    _webpage += "  vAxes: {0: {title: '"; _webpage += Units; _webpage += "'}, 1: {minValue: 0, maxValue: 100, textPosition: 'none', gridlines: {count: 0}}},";
+    _webpage += "  seriesType: 'line',";
+    _webpage += "  series: {2: {type: 'steppedArea', targetAxisIndex: 1, areaOpacity: 0.2, lineWidth: 0}},";
+  }
+  else {
+    _webpage += "  vAxis: {color: '#FFF', title: '"; _webpage += Units; _webpage += "'},";
+  }
   _webpage += "  curveType: 'function',";
   _webpage += "  pointSize: 1,";
   _webpage += "  lineWidth: 1,";
   _webpage += "  width:  450,";
   _webpage += "  height: 280,";
-  _webpage += "  colors:['" + Colour + (Type == "GraphT" ? "', 'orange" : "") + "'],";
+  _webpage += "  colors:['"; _webpage += Colour; _webpage += (Type == "GraphT" ? "', 'orange', 'purple']," : "'],");
   _webpage += "  legend: { position: 'right' }";
   _webpage += " };";
-  _webpage += " var chart = new google.visualization.LineChart(document.getElementById('" + Div + GraphType + String(Channel) + "'));";
+  _webpage += " var chart = new google.visualization."; _webpage += (Type == "GraphT" ? "ComboChart" : "LineChart");
+  _webpage += "(document.getElementById('"; _webpage += Div; _webpage += GraphType; _webpage += Channel; _webpage += "'));";
+  _webpage += "  chart.draw(data, options);";
+  _webpage += " };";
+}
+
+
+void add_DutyGraph(const String &Div) {
+  _webpage += "function drawDuty() {";
+  _webpage += " var data = google.visualization.arrayToDataTable([['Hour', 'Heating %'],";
+  for (int h = 23; h >= 0; h--) {                           // Last 24 hours, oldest first
+    time_t HourStart = (_unixTime / 3600 - h) * 3600;
+    char Row[24];
+    strftime(Row, sizeof(Row), "['%H:%M',", localtime(&HourStart));
+    _webpage += Row;
+    snprintf(Row, sizeof(Row), "%.0f],", _relay.hourOnSeconds(HourStart) / 36.0);
+    _webpage += Row;
+  }
+  _webpage += " ]);";
+  _webpage += " var options = {";
+  _webpage += "  title: 'Heater duty cycle by hour',";
+  _webpage += "  titleFontSize: 14,";
+  _webpage += "  backgroundColor: '"; _webpage += BACKGROUND_COLOR; _webpage += "',";
+  _webpage += "  titleTextStyle:  { color: '"; _webpage += TITLE_COLOR;  _webpage += "' },";
+  _webpage += "  vAxis: {minValue: 0, maxValue: 100, title: '%'},";
+  _webpage += "  width:  900,";
+  _webpage += "  height: 200,";
+  _webpage += "  colors:['red'],";
+  _webpage += "  legend: { position: 'none' }";
+  _webpage += " };";
+  _webpage += " var chart = new google.visualization.ColumnChart(document.getElementById('"; _webpage += Div; _webpage += "'));";
   _webpage += "  chart.draw(data, options);";
   _webpage += " };";
 }
 
+void add_DutyTable() {
+  _webpage += "<table class='centre'>";
+  _webpage += "<tr><td>Day</td><td>Heating ON</td><td>Duty cycle</td><td>Energy (est.)</td></tr>";
+  for (int d = 0; d < 7; d++) {                              // Today first, then the previous 6 days
+    time_t DayTime = _unixTime - d * 86400;
+    uint32_t OnSeconds = _relay.dayOnSeconds(DayTime);
+    char OnTime[8];
+    snprintf(OnTime, sizeof(OnTime), "%02u:%02u", (unsigned)(OnSeconds / 3600), (unsigned)(OnSeconds / 60 % 60));
+    char Cells[64];
+    snprintf(Cells, sizeof(Cells), "</td><td>%s</td><td>%.1f%%</td><td>%.2f kWh</td></tr>", OnTime, OnSeconds / 864.0, OnSeconds * (float)HEATER_POWER / 3600000.0);
+    _webpage += "<tr><td>";
+    if (d == 0) _webpage += "Today"; else _webpage += _timer[localtime(&DayTime)->tm_wday].DoW;
+    _webpage += Cells;
+  }
+  _webpage += "</table>";
+}
 
 void HomePage() {
   readSensor();
   append_HTML_header(REFRESH);
   _webpage += "<h2>Smart Thermostat Status</h2><br>";
-  _webpage += "<div class='numberCircle'><span class=" + String((_relayState == "ON" ? "'on'>" : "'off'>")) + String(_temperature, 1) + "&deg;</span></div><br><br><br>";
+  _webpage += "<div class='numberCircle'><span class=" + String((_relay.isOn() ? "'on'>" : "'off'>")) + String(_temperature, 1) + "&deg;</span></div><br><br><br>";
   _webpage += "<table class='centre'>";
   _webpage += "<tr>";
   _webpage += "<td>Temperature</td>";
@@ -545,7 +892,7 @@ void HomePage() {
   _webpage += "<td class='large'>" + String(_temperature, 1)       + "&deg;</td>";
   _webpage += "<td class='large'>" + String(_humidity, 0)          + "%</td>";
   _webpage += "<td class='large'>" + String(_targetTemp, 1) + "&deg;</td>";
-  _webpage += "<td class='large'><span class=" + String((_relayState == "ON" ? "'on'>" : "'off'>")) + _relayState + "</span></td>"; // (condition ? that : this) if this then that else this
+  _webpage += "<td class='large'><span class=" + String((_relay.isOn() ? "'on'>" : "'off'>")) + relayStateString() + "</span></td>"; // (condition ? that : this) if this then that else this
   _webpage += "<td class='large'><span class=" + String((_timerState == "ON" ? "'on'>" : "'off'>")) + _timerState + "</span></td>";
   if (_manualOverride) {
     _webpage += "<td class='large'>" + String(_manualOverride ? "ON" : "OFF") + "</td>";
@@ -553,6 +900,20 @@ void HomePage() {
   _webpage += "</tr>";
   _webpage += "</table>";
   _webpage += "<br>";
+  if (_ingest.nodes() > 0) {
+    _webpage += "<h3>Remote Sensors</h3>";
+    _webpage += "<table class='centre'>";
+    _webpage += "<tr><td>Node</td><td>Temperature</td><td>Humidity</td><td>Battery</td><td>Last seen</td><td>Readings</td><td>Lost</td><td>Duplicates</td><td>Out of order</td></tr>";
+    for (size_t i = 0; i < _ingest.nodes(); i++) {
+      const SensorNodeStats &Node = _ingest.node(i);
+      _webpage += "<tr><td>" + String(Node.Node) + "</td>";
+      _webpage += "<td>" + String(Node.Last.Temp, 1) + "&deg;</td><td>" + String(Node.Last.Humi) + "%</td><td>" + String(Node.Last.Battery) + "%</td>";
+      _webpage += "<td>" + String((millis() - Node.LastSeenMs) / 1000) + "s ago</td>";
+      _webpage += "<td>" + String(Node.Readings) + "</td><td>" + String(Node.Lost) + "</td><td>" + String(Node.Duplicates) + "</td><td>" + String(Node.Reordered) + "</td></tr>";
+    }
+    _webpage += "</table>";
+    _webpage += "<p class='ps'>" + String(_ingest.unauthenticated()) + " unauthenticated, " + String(_ingest.malformed()) + " malformed packets</p>";
+  }
   append_HTML_footer();
 }
 
@@ -564,8 +925,10 @@ void GraphsPage() {
   _webpage += "google.charts.load('current', {'packages':['corechart']});";
   _webpage += "google.charts.setOnLoadCallback(drawGraphT1);"; // Pre-load function names for Temperature graphs
   _webpage += "google.charts.setOnLoadCallback(drawGraphH1);"; // Pre-load function names for Humidity graphs
+  _webpage += "google.charts.setOnLoadCallback(drawDuty);";    // Pre-load function name for the heater duty cycle graph
   add_Graph(1, "GraphT", "Temperature", "TS", "°C", "red",  "chart_div");
   add_Graph(1, "GraphH", "Humidity",    "HS", "%",  "blue", "chart_div");
+  add_DutyGraph("chart_divDuty");
   _webpage += "</script>";
   _webpage += "<div id='outer'>";
   _webpage += "<table>";
@@ -576,7 +939,10 @@ void GraphsPage() {
   _webpage += "</table>";
   _webpage += "<br>";
   _webpage += "</div>";
-  _webpage += "<p>Heating status : <span class=" + String((_relayState == "ON" ? "'on'>" : "'off'>")) + _relayState + "</span></p>";
+  _webpage += "<div id='chart_divDuty' class='centre' style='width:900px'></div>";
+  add_DutyTable();
+  _webpage += "<p>Relay switches : " + String(_relay.transitions()) + ", held back by the minimum ON/OFF time : " + String(_relay.deferred()) + "</p>";
+  _webpage += "<p>Heating status : <span class=" + String((_relay.isOn() ? "'on'>" : "'off'>")) + relayStateString() + "</span></p>";
   append_HTML_footer();
 }
 
@@ -626,11 +992,62 @@ void TimerSetPage() {
   }
   _webpage += "</table>";
   _webpage += "<div class='centre'>";
-  _webpage += "<br><input type='submit' value='Enter'><br><br>";
+  _webpage += "<br><input type='submit' value='Enter'> <input type='submit' formaction='/simulate' value='Preview'><br><br>";
   _webpage += "</div></form>";
   append_HTML_footer();
 }
 
+String exceptionKindName(byte Kind) {
+  if (Kind == EXCEPTION_HOLIDAY)  return "Holiday";
+  if (Kind == EXCEPTION_SETPOINT) return "Set-point";
+  return "Away";
+}
+
+void CalendarPage() {
+  append_HTML_header(NO_REFRESH);
+  _webpage += "<h2>Thermostat Calendar</h2><br>";
+  _webpage += "<h3>Away, holiday and one-off set-point periods override the weekly schedule</h3><br>";
+  _webpage += "<table class='centre'>";
+  _webpage += "<tr><td>From</td><td>To</td><td>Mode</td><td>Value</td><td></td></tr>";
+  int Pages = _calendar.size() > 0 ? (_calendar.size() + CALENDAR_PAGE_ROWS - 1) / CALENDAR_PAGE_ROWS : 1;
+  int Page  = constrain(_calendarPage, 0, Pages - 1);
+  for (size_t i = (size_t)Page * CALENDAR_PAGE_ROWS; i < _calendar.size() && i < (size_t)(Page + 1) * CALENDAR_PAGE_ROWS; i++) {
+    const CalendarException &Exception = _calendar.at(i);
+    _webpage += "<tr>";
+    _webpage += "<td>" + convertUnixDate(Exception.Start) + "</td>";
+    _webpage += "<td>" + convertUnixDate(Exception.Stop) + "</td>";
+    _webpage += "<td>" + exceptionKindName(Exception.Kind) + "</td>";
+    if (Exception.Kind == EXCEPTION_HOLIDAY)       _webpage += "<td>" + _timer[(int)Exception.Value].DoW + " schedule</td>";
+    else if (Exception.Kind == EXCEPTION_SETPOINT) _webpage += "<td>" + String(Exception.Value, 1) + "&deg;</td>";
+    else                                           _webpage += "<td>Frost protection</td>";
+    _webpage += "<td><a href='/handlecalendar?delete=" + String(i) + "&amp;page=" + String(Page) + "'>Delete</a></td>";
+    _webpage += "</tr>";
+  }
+  _webpage += "</table>";
+  if (Pages > 1) {
+    _webpage += "<p>";
+    if (Page > 0) _webpage += "<a href='/calendar?page=" + String(Page - 1) + "'>Previous</a> ";
+    _webpage += "Page " + String(Page + 1) + " of " + String(Pages);
+    if (Page < Pages - 1) _webpage += " <a href='/calendar?page=" + String(Page + 1) + "'>Next</a>";
+    _webpage += "</p>";
+  }
+  _webpage += "<br>";
+  _webpage += "<FORM action='/handlecalendar'>";
+  _webpage += "<table class='centre'>";
+  _webpage += "<tr><td>From</td><td>To</td><td>Mode</td><td>Value</td></tr>";
+  _webpage += "<tr>";
+  _webpage += "<td><input type='datetime-local' name='start' required></td>";
+  _webpage += "<td><input type='datetime-local' name='stop' required></td>";
+  _webpage += "<td><select name='kind'><option value='0'>Away</option><option value='1'>Holiday</option><option value='2'>Set-point</option></select></td>";
+  _webpage += "<td><input type='text' size='6' name='value' value=''></td>"; // Set-point temperature or holiday day of week 0-6 (Sun-Sat)
+  _webpage += "</tr>";
+  _webpage += "</table>";
+  _webpage += "<br><input type='submit' value='Add'><br><br>";
+  _webpage += "</form>";
+  _webpage += "<p>" + String(_calendar.size()) + " of " + String(MAX_EXCEPTIONS) + " calendar entries used</p>";
+  append_HTML_footer();
+}
+
 void SetupPage() {
   append_HTML_header(NO_REFRESH);
   _webpage += "<h2>Thermostat System Setup</h2><br>";
@@ -653,6 +1070,14 @@ void SetupPage() {
   _webpage += "<td><input type='text' size='4' pattern='[0-9]*' name='earlystart' value='" + String(_earlyStart) + "'></td>"; // 00-99 valid input style
   _webpage += "</tr>";
   _webpage += "<tr>";
+  _webpage += "<td><label for='minontime'>Minimum heating ON time (mins) [NN]</label></td>";
+  _webpage += "<td><input type='text' size='4' pattern='[0-9]*' name='minontime' value='" + String(_minOnTime) + "'></td>"; // 00-99 valid input style
+  _webpage += "</tr>";
+  _webpage += "<tr>";
+  _webpage += "<td><label for='minofftime'>Minimum heating OFF time (mins) [NN]</label></td>";
+  _webpage += "<td><input type='text' size='4' pattern='[0-9]*' name='minofftime' value='" + String(_minOffTime) + "'></td>"; // 00-99 valid input style
+  _webpage += "</tr>";
+  _webpage += "<tr>";
   _webpage += "<td><label for='manualoveride'>Manual heating over-ride </label></td>";
   _webpage += "<td><select name='manualoverride'><option value='ON'>ON</option>";
   _webpage += "<option selected value='OFF'>OFF</option></select></td>"; // ON/OFF
@@ -665,6 +1090,186 @@ void SetupPage() {
   append_HTML_footer();
 }
 
+void LogPage() {
+  LogRecord Record;
+  char Line[LOG_LINE_LENGTH];
+  _webpage = "Recent log, oldest first, " + String(_log.dropped()) + " records dropped\n\n";
+  for (int i = 0; i < LOG_HISTORY_SIZE; i++) {
+    portENTER_CRITICAL(&_logHistoryMux);
+    bool Valid = i < _logHistoryCount;
+    if (Valid) Record = _logHistory[(_logHistoryHead + LOG_HISTORY_SIZE - _logHistoryCount + i) % LOG_HISTORY_SIZE];
+    portEXIT_CRITICAL(&_logHistoryMux);
+    if (!Valid) break;
+    formatLogLine(Record, Line, sizeof(Line));
+    _webpage += Line;
+    _webpage += "\n";
+  }
+}
+
+void add_Duration(uint32_t Seconds) {
+  char Output[8];
+  snprintf(Output, sizeof(Output), "%02u:%02u", (unsigned)(Seconds / 3600), (unsigned)(Seconds / 60 % 60)); // Appends 02:15
+  _webpage += Output;
+}
+
+void add_StatsRow(const String &Period, const ComfortStats *Stats) {
+  _webpage += "<tr><td>"; _webpage += Period; _webpage += "</td>";
+  if (Stats) {
+    char Cells[128];
+    snprintf(Cells, sizeof(Cells), "<td>%.1f</td><td>%.1f</td><td>%.1f</td><td>%.0f</td><td>%.0f</td><td>%.0f</td><td>",
+             Stats->TempMin, Stats->tempMean(), Stats->TempMax, Stats->HumiMin, Stats->humiMean(), Stats->HumiMax);
+    _webpage += Cells;
+    add_Duration(Stats->SecondsBelow);
+    _webpage += "</td><td>";
+    add_Duration(Stats->SecondsAbove);
+    snprintf(Cells, sizeof(Cells), "</td><td>%.1f</td><td>", Stats->DegreeHours);
+    _webpage += Cells;
+    add_Duration(Stats->HeatSeconds);
+    _webpage += "</td>";
+  }
+  else
+    _webpage += "<td colspan='10'>-</td>";
+  _webpage += "</tr>";
+}
+
+void StatsPage() {
+  int LocalTime = _unixTime + _utcOffset;
+  append_HTML_header(NO_REFRESH);
+  _webpage += "<h2>Comfort and Energy Statistics</h2><br>";
+  _webpage += "<table class='centre'>";
+  _webpage += "<tr><td>Period</td><td>T min&deg;</td><td>T mean&deg;</td><td>T max&deg;</td><td>RH min %</td><td>RH mean %</td><td>RH max %</td>";
+  _webpage += "<td>Below target</td><td>Above target</td><td>Degree-hours</td><td>Heating ON</td></tr>";
+  for (int d = 0; d < STATS_DAYS; d++) {                    // Today first, then the previous days
+    time_t DayTime = _unixTime - d * 86400;
+    add_StatsRow(d == 0 ? String("Today") : _timer[localtime(&DayTime)->tm_wday].DoW, _stats.day(LocalTime - d * 86400));
+  }
+  for (int h = 0; h < STATS_HOURS; h++) {                   // This hour first, then the previous hours
+    add_StatsRow(convertUnixTime((_unixTime / 3600 - h) * 3600), _stats.hour(LocalTime - h * 3600));
+  }
+  _webpage += "</table>";
+  _webpage += "<p>Also available as <a href='/stats.json'>JSON</a></p>";
+  append_HTML_footer();
+}
+
+void add_StatsJSON(const ComfortStats *Stats, int Start) {
+  char Member[256];
+  snprintf(Member, sizeof(Member), "{\"start\":%d", Start);
+  _webpage += Member;
+  if (Stats) {
+    snprintf(Member, sizeof(Member), ",\"samples\":%u,\"temp_min\":%.1f,\"temp_mean\":%.2f,\"temp_max\":%.1f,\"humi_min\":%.0f,\"humi_mean\":%.1f,\"humi_max\":%.0f"
+             ",\"seconds\":%u,\"seconds_below\":%u,\"seconds_above\":%u,\"degree_hours\":%.2f,\"heat_seconds\":%u",
+             (unsigned)Stats->Samples, Stats->TempMin, Stats->tempMean(), Stats->TempMax, Stats->HumiMin, Stats->humiMean(), Stats->HumiMax,
+             (unsigned)Stats->Seconds, (unsigned)Stats->SecondsBelow, (unsigned)Stats->SecondsAbove, Stats->DegreeHours, (unsigned)Stats->HeatSeconds);
+    _webpage += Member;
+  }
+  _webpage += "}";
+}
+
+void StatsJSON() {
+  int LocalTime = _unixTime + _utcOffset;
+  _webpage  = "{\"name\":\"" + String(SERVER_NAME) + "\",\"time\":" + String(_unixTime);
+  _webpage += ",\"heater_power\":" + String(HEATER_POWER);
+  _webpage += ",\"relay\":{\"on\":" + String(_relay.isOn() ? "true" : "false") + ",\"switches\":" + String(_relay.transitions());
+  _webpage += ",\"deferred\":" + String(_relay.deferred()) + ",\"journal\":[";
+  for (size_t i = 0; i < _relay.journalSize(); i++) {       // Oldest first, time 0 when the clock was not yet set
+    char Entry[24];
+    snprintf(Entry, sizeof(Entry), "%s[%u,%d]", i > 0 ? "," : "", (unsigned)_relay.journal(i).Time, _relay.journal(i).On ? 1 : 0);
+    _webpage += Entry;
+  }
+  _webpage += "]},\"days\":[";
+  for (int d = 0; d < STATS_DAYS; d++) {                    // Periods start at local midnight / hour, given as Unix time
+    if (d > 0) _webpage += ",";
+    add_StatsJSON(_stats.day(LocalTime - d * 86400), (LocalTime / 86400 - d) * 86400 - _utcOffset);
+  }
+  _webpage += "],\"hours\":[";
+  for (int h = 0; h < STATS_HOURS; h++) {
+    if (h > 0) _webpage += ",";
+    add_StatsJSON(_stats.hour(LocalTime - h * 3600), (LocalTime / 3600 - h) * 3600 - _utcOffset);
+  }
+  _webpage += "]}";
+}
+
+// Reads a candidate schedule and settings, with the same argument names as /handletimer and /handlesetup; anything absent is the current value
+void readSimulationRequest(AsyncWebServerRequest *request) {
+  _simulation.Schedule = _schedule;
+  if (request->hasArg("0.0.Start")) {
+    for (byte dow = 0; dow < 7; dow++) {
+      for (byte p = 0; p < NUM_OF_EVENTS; p++) {
+        String Period = String(dow) + "." + String(p) + ".";
+        _simulation.Schedule.Days[dow][p].Start = parseClock(request->arg(Period + "Start").c_str());
+        _simulation.Schedule.Days[dow][p].Stop  = parseClock(request->arg(Period + "Stop").c_str());
+        _simulation.Schedule.Days[dow][p].Temp  = request->arg(Period + "Temp").toFloat();
+      }
+    }
+  }
+  ControlSettings &Settings = _simulation.Settings;
+  Settings = controlSettings();
+  if (request->hasArg("hysteresis"))         Settings.Hysteresis      = request->arg("hysteresis").toFloat();
+  if (request->hasArg("frosttemp"))          Settings.FrostTemp       = request->arg("frosttemp").toFloat();
+  if (request->hasArg("earlystart"))         Settings.EarlyStart      = request->arg("earlystart").toInt();
+  if (request->hasArg("minontime"))          Settings.MinOnTime       = constrain(request->arg("minontime").toInt(), 0, 99);
+  if (request->hasArg("minofftime"))         Settings.MinOffTime      = constrain(request->arg("minofftime").toInt(), 0, 99);
+  if (request->hasArg("manualoverridetemp")) Settings.ManOverrideTemp = request->arg("manualoverridetemp").toFloat();
+  _simulation.State.TargetTemp     = _targetTemp;
+  _simulation.State.ManualOverride = request->hasArg("manualoverride") ? request->arg("manualoverride") == "ON" : _manualOverride;
+  ThermalModel &Model = _simulation.Model;
+  Model = ThermalModel();
+  Model.StartTemp = _temperature;
+  if (request->hasArg("starttemp")) Model.StartTemp   = request->arg("starttemp").toFloat();
+  if (request->hasArg("outside"))   Model.Outside     = request->arg("outside").toFloat();
+  if (request->hasArg("loss"))      Model.LossPerHour = request->arg("loss").toFloat();
+  if (request->hasArg("gain"))      Model.GainPerHour = request->arg("gain").toFloat();
+  _simulation.Replay = request->arg("trace") == "history";
+  _simulation.Days   = request->hasArg("days") ? constrain(request->arg("days").toInt(), 1, 7) : 7;
+}
+
+class SimulationTimeline : public SimulationObserver {
+public:
+  void setpoint(uint32_t Minute, float Target, bool TimerOn) override {
+    if (Changes++ >= MAX_SIMULATION_CHANGES) return;       // Still counted in changes_total
+    if (Changes > 1) _webpage += ",";
+    _webpage += "[" + String(Minute) + "," + String(Target, 1) + "," + String(TimerOn ? 1 : 0) + "]";
+  }
+  void hour(uint32_t Hour, float MeanTemp, uint32_t HeatMinutes) override {
+    Temp[Hour] = MeanTemp;
+    Heat[Hour] = HeatMinutes;
+    Hours = Hour + 1;
+  }
+  uint32_t Changes = 0;
+  uint32_t Hours   = 0;
+  float    Temp[SIMULATION_WEEK / 60];
+  byte     Heat[SIMULATION_WEEK / 60];
+};
+
+SimulationTimeline _timeline;              // Too large for the web server task's stack
+float _simulationTrace[MAX_SENSOR_READINGS];
+
+// Previews the schedule from local midnight today, against the calendar, at the current UTC offset throughout
+void SimulationJSON() {
+  TemperatureTrace Trace;
+  if (_simulation.Replay && _sensorReadingPointer[1] > 0) { // Open loop over the recorded history, repeated as needed
+    for (int r = 0; r < _sensorReadingPointer[1]; r++) _simulationTrace[r] = _sensorData[1][r].Temp;
+    Trace.Temps   = _simulationTrace;
+    Trace.Count   = _sensorReadingPointer[1];
+    Trace.Minutes = _lastReadingDuration;
+  }
+  uint32_t Start = _unixTime - (_unixTime + _utcOffset) % 86400;
+  _timeline = SimulationTimeline();
+  _webpage  = "{\"start\":" + String(Start) + ",\"trace\":\"" + String(Trace.Temps ? "history" : "model") + "\",\"changes\":[";
+  uint32_t Began = micros();
+  SimulationResult Result = simulateSchedule(_simulation.Schedule, _simulation.Settings, _simulation.State, &_calendar, Start, _utcOffset,
+                                             _simulation.Days * 24 * 60, Trace, _simulation.Model, &_timeline);
+  uint32_t Elapsed = micros() - Began;
+  _webpage += "],\"hours\":[";
+  for (uint32_t h = 0; h < _timeline.Hours; h++) {
+    if (h > 0) _webpage += ",";
+    _webpage += "[" + String(_timeline.Temp[h], 1) + "," + String(_timeline.Heat[h]) + "]";
+  }
+  char Summary[320];
+  formatSimulationSummary(Result, HEATER_POWER, Summary, sizeof(Summary));
+  _webpage += "],\"changes_total\":" + String(_timeline.Changes) + "," + Summary + ",\"elapsed_ms\":" + String(Elapsed / 1000.0, 1) + "}";
+}
+
 void HelpPage() {
   append_HTML_header(NO_REFRESH);
   _webpage += "<h2>Help</h2><br>";
@@ -676,19 +1281,36 @@ void HelpPage() {
   _webpage += "<p><i>Frost Protection Temperature</i> - this setting is used to protect from low temperatures and pipe freezing in cold conditions. ";
   _webpage += "It helps prevent low temperature damage by turning on the heating until the risk of freezing has been prevented.</p>";
   _webpage += "<p><i>Early Start Duration</i> - if greater than 0, begins heating earlier than scheduled so that the scheduled temperature is reached by the set time.</p>";
+  _webpage += "<p><i>Minimum ON/OFF time</i> - once switched, the heating stays ON (or OFF) for at least this many minutes to protect the boiler from short cycling. ";
+  _webpage += "Over-temperature protection always switches the heating OFF immediately.</p>";
   _webpage += "<p><i>Heating Manual Override</i> - switch the heating on and control to the desired temperature, switched-off when the next timed period begins.</p>";
   _webpage += "<p><i>Heating Manual Override Temperature</i> - used to set the desired manual override temperature.</p>";
   _webpage += "<u><b>Schedule Menu</b></u>";
   _webpage += "<p>Determines the heating temperature for each day of the week and up to 4 heating periods in a day. ";
   _webpage += "To set the heating to come on at 06:00 and off at 09:00 with a temperature of 20&deg; enter 20 then the required start/end times. ";
   _webpage += "Repeat for each day of the week and heating period within the day for the required heat profile.</p>";
+  _webpage += "<u><b>Calendar Menu</b></u>";
+  _webpage += "<p>Adds date ranges that override the weekly schedule. <i>Away</i> suspends the schedule and leaves only frost protection, ";
+  _webpage += "<i>Holiday</i> follows the schedule of another day, enter its number as the value (0 = Sun to 6 = Sat), ";
+  _webpage += "<i>Set-point</i> holds the temperature entered as the value for the whole period. Finished entries are removed automatically.</p>";
   _webpage += "<u><b>Graph Menu</b></u>";
-  _webpage += "<p>Displays the target temperature set and the current measured temperature and humidity. ";
+  _webpage += "<p>Displays the target temperature set and the current measured temperature and humidity, with shaded bands when the heating was ON. ";
+  _webpage += "Below are the heater duty cycle for each of the last 24 hours and the daily ON time and estimated energy use for the last week. ";
   _webpage += "Thermostat status is also displayed as temperature varies.</p>";
+  _webpage += "<u><b>Stats Menu</b></u>";
+  _webpage += "<p>Shows, for each of the last 7 days and 24 hours, the minimum, mean and maximum temperature and humidity, ";
+  _webpage += "the time the room was below or above the target by more than the hysteresis, the heating demand in degree-hours ";
+  _webpage += "and the time the heating was ON. Outside scheduled periods the target is the frost protection temperature.</p>";
   _webpage += "<u><b>Status Menu</b></u>";
   _webpage += "<p>Displays the current temperature and humidity. ";
   _webpage += "Displays the temperature the thermostat is controlling towards, the current state of the thermostat (ON/OFF) and ";
   _webpage += "timer status (ON/OFF).</p>";
+  _webpage += "<u><b>Diagnostics</b></u>";
+  _webpage += "<p>The most recent log messages are shown at <a href='/log'>/log</a>, they are also written to the serial port.</p>";
+  _webpage += "<u><b>Schedule Preview</b></u>";
+  _webpage += "<p><i>Preview</i> on the Schedule Menu runs the entered schedule over the coming week, calendar included, without saving it. ";
+  _webpage += "It reports the heating time, estimated energy, relay switches and how far the room falls short of the target while the timer is ON. ";
+  _webpage += "The room is modelled as losing heat to a 5&deg;C outside, add <i>trace=history</i> to <a href='/simulate'>/simulate</a> to replay the recorded temperatures instead.</p>";
   _webpage += "</div>";
   append_HTML_footer();
 }
@@ -696,35 +1318,81 @@ void HelpPage() {
 //#########################################
 //################ SERVER #################
 //#########################################
+void sendPage(AsyncWebServerRequest *request, byte Priority, void (*Render)(), const char *ContentType = "text/html") {
+  int Slot = _responses.acquire(Priority);                 // Admission, a slot is only free when there is room for the response
+  if (Slot < 0) {
+    LOG_WARN(LOG_REQUEST_REJECTED, Priority, _responses.inFlight());
+    AsyncWebServerResponse *response = request->beginResponse(503, "text/plain", "Busy, please retry");
+    response->addHeader("Retry-After", String(RETRY_AFTER));
+    request->send(response);
+    return;
+  }
+  Render();                                                // Renders into _webpage, whose capacity is reserved at start up
+  size_t Length = _webpage.length();
+  if (Length > RESPONSE_BUFFER_SIZE) {
+    _responses.release(Slot);
+    LOG_ERROR(LOG_RESPONSE_TOO_LARGE, Length);
+    request->send(500, "text/html", "<!DOCTYPE html><html><head><title>" + SITE_TITLE + "</title></head><body><h2>Page too large</h2>"
+                  "<p>This page needs " + String(Length) + " bytes, more than the " + String(RESPONSE_BUFFER_SIZE) + " byte response buffer.</p>"
+                  "<p><a href='/homepage'>Back to the status page</a></p></body></html>");
+    return;
+  }
+  memcpy(_responses.buffer(Slot), _webpage.c_str(), Length);
+  request->onDisconnect([Slot]() { _responses.release(Slot); }); // The buffer is in use until the client has gone
+  request->send(request->beginResponse(ContentType, Length, [Slot, Length](uint8_t *Buffer, size_t MaxLen, size_t Index) -> size_t {
+    size_t Count = (Length - Index < MaxLen) ? Length - Index : MaxLen;
+    memcpy(Buffer, _responses.buffer(Slot) + Index, Count);
+    return Count;
+  }));
+}
+
 void startServer(){
+  _webpage.reserve(RESPONSE_BUFFER_SIZE);                  // Allocate once so page rendering never reallocates
   // Set handler for '/'
   server.on("/", HTTP_GET, [](AsyncWebServerRequest * request) {
     request->redirect("/homepage");       // Go to home page
   });
   // Set handler for '/homepage'
   server.on("/homepage", HTTP_GET, [](AsyncWebServerRequest * request) {
-    HomePage();
-    request->send(200, "text/html", _webpage);
+    sendPage(request, PRIORITY_STATUS, HomePage);
   });
   // Set handler for '/graphs'
-  server.on("/graphs", HTTP_GET, [](AsyncWebServerRequest * request)   {
-    GraphsPage();
-    request->send(200, "text/html", _webpage);
+  server.on("/graphs", HTTP_GET, [](AsyncWebServerRequest * request) {
+    sendPage(request, PRIORITY_DECORATIVE, GraphsPage);
   });
   // Set handler for '/timer'
   server.on("/timer", HTTP_GET, [](AsyncWebServerRequest * request) {
-    TimerSetPage();
-    request->send(200, "text/html", _webpage);
+    sendPage(request, PRIORITY_STATUS, TimerSetPage);
+  });
+  // Set handler for '/calendar'
+  server.on("/calendar", HTTP_GET, [](AsyncWebServerRequest * request) {
+    _calendarPage = request->arg("page").toInt();          // First page when absent
+    sendPage(request, PRIORITY_STATUS, CalendarPage);
   });
   // Set handler for '/setup'
   server.on("/setup", HTTP_GET, [](AsyncWebServerRequest * request) {
-    SetupPage();
-    request->send(200, "text/html", _webpage);
+    sendPage(request, PRIORITY_STATUS, SetupPage);
   });
   // Set handler for '/help'
   server.on("/help", HTTP_GET, [](AsyncWebServerRequest * request) {
-    HelpPage();
-    request->send(200, "text/html", _webpage);
+    sendPage(request, PRIORITY_DECORATIVE, HelpPage);
+  });
+  // Set handler for '/stats'
+  server.on("/stats", HTTP_GET, [](AsyncWebServerRequest * request) {
+    sendPage(request, PRIORITY_DECORATIVE, StatsPage);
+  });
+  // Set handler for '/stats.json'
+  server.on("/stats.json", HTTP_GET, [](AsyncWebServerRequest * request) {
+    sendPage(request, PRIORITY_CONTROL, StatsJSON, "application/json");
+  });
+  // Set handler for '/log'
+  server.on("/log", HTTP_GET, [](AsyncWebServerRequest * request) {
+    sendPage(request, PRIORITY_DECORATIVE, LogPage, "text/plain");
+  });
+  // Set handler for '/simulate', heavier than the other API calls but bounded to a week of one-minute steps
+  server.on("/simulate", HTTP_GET, [](AsyncWebServerRequest * request) {
+    readSimulationRequest(request);
+    sendPage(request, PRIORITY_STATUS, SimulationJSON, "application/json");
   });
   // Set handler for '/handletimer' inputs
   server.on("/handletimer", HTTP_GET, [](AsyncWebServerRequest * request) {
@@ -735,9 +1403,26 @@ void startServer(){
         _timer[dow].Stop[p]  = request->arg(String(dow) + "." + String(p) + ".Stop");
       }
     }
+    compileSchedule(_timer, _schedule);
     saveSettingsPage();
     request->redirect("/homepage");                       // Go back to home page
   });
+  // Set handler for '/handlecalendar' inputs
+  server.on("/handlecalendar", HTTP_GET, [](AsyncWebServerRequest * request) {
+    if (request->hasArg("delete")) {
+      _calendar.remove(request->arg("delete").toInt());
+    }
+    else if (request->hasArg("start") && request->hasArg("stop")) {
+      CalendarException Exception;
+      Exception.Start = parseDateTime(request->arg("start"));
+      Exception.Stop  = parseDateTime(request->arg("stop"));
+      Exception.Kind  = request->arg("kind").toInt();
+      Exception.Value = request->arg("value").toFloat();
+      if (Exception.Start == 0 || Exception.Stop == 0 || !_calendar.add(Exception)) LOG_WARN(LOG_CALENDAR_REJECTED); // Blank or malformed dates too
+    }
+    saveCalendar();
+    request->redirect("/calendar?page=" + String(request->arg("page").toInt())); // Go back to the calendar page the entry was on
+  });
   // Set handler for '/handlesetup' inputs
   server.on("/handlesetup", HTTP_GET, [](AsyncWebServerRequest * request) {
     if (request->hasArg("hysteresis")) {
@@ -752,6 +1437,15 @@ void startServer(){
       String numArg = request->arg("earlystart");
       _earlyStart    = numArg.toInt();
     }
+    if (request->hasArg("minontime")) {
+      String numArg = request->arg("minontime");
+      _minOnTime     = constrain(numArg.toInt(), 0, 99); // A negative dwell would lock the relay
+    }
+    if (request->hasArg("minofftime")) {
+      String numArg = request->arg("minofftime");
+      _minOffTime    = constrain(numArg.toInt(), 0, 99);
+    }
+    _relay.configure(_minOnTime * 60, _minOffTime * 60);
     if (request->hasArg("manualoverride")) {
       String stringArg = request->arg("manualoverride");
       if (stringArg == "ON") _manualOverride = true; else _manualOverride = false;
@@ -772,26 +1466,37 @@ void startServer(){
 //#########################################
 void setup() {
   setupSystem();                          // General system setup
-  startWiFi();                            // Start WiFi services
-  setupTime();                            // Start NTP clock services
+  bool WarmStart = restoreCheckpoint();   // After a reset resume relay, override, clock and history straight away
+  if (!WarmStart) startRelay(OFF);        // Switch heating OFF
   startSPIFFS();                          // Start SPIFFS filing system
   initialise_Array();                     // Initialise the array for storage and set some values
   recoverSettings();                      // Recover settings from LittleFS
-  setupDeviceName(SERVER_NAME);            // Set logical device name
-  startServer();
-
+  _relay.configure(_minOnTime * 60, _minOffTime * 60);
+  recoverCalendar();                      // Recover holiday/away calendar from SPIFFS
   startSensor();
   readSensor();                                           // Get current sensor values
-  for (int r = 0; r < MAX_SENSOR_READINGS; r++) {
-    _sensorData[1][r].Temp = _temperature;
-    _sensorData[1][r].Humi = _humidity;
+  if (!WarmStart || _sensorReadingPointer[1] == 0) {      // No history kept, start it from the current reading
+    for (int r = 0; r < MAX_SENSOR_READINGS; r++) {
+      _sensorData[1][r].Temp = _temperature;
+      _sensorData[1][r].Humi = _humidity;
+    }
+  }
+  if (WarmStart && _checkpoint.Epoch > 0) {               // Control again straight away from the restored clock, not after the network is up
+    setTimeZone();
+    updateLocalTime();
+    CheckTimerEvent();
   }
-  switchRelay(OFF);                                    // Switch heating OFF
+  startWiFi();                            // Start WiFi services
+  setupTime();                            // Start NTP clock services
+  setupDeviceName(SERVER_NAME);            // Set logical device name
+  startServer();
+  startRemoteSensors();                   // Listen for remote sensor nodes, when a key is configured
   readSensor();                                           // Get current sensor values
   _lastTimerSwitchCheck = millis() + _timerCheckDuration;   // preload timer value with update duration
 }
 
 void loop() {
+  if (_remoteSensors) readRemoteSensors();                // Take in any packets from remote sensor nodes
 
   if ((millis() - _lastTimerSwitchCheck) > _timerCheckDuration) {
     _lastTimerSwitchCheck = millis();                      // Reset time
@@ -0,0 +1,108 @@
+// Native build of the remote sensor ingestion path, for throughput testing on Linux with sensor_client.
+// Runs the same SensorIngest code as the thermostat and reports packets and readings per second.
+//   .pio/build/native_ingest/program [port] [key] [seconds]
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "ingest.hpp"
+
+const int    DEFAULT_PORT = 4210;
+const char  *DEFAULT_KEY = "000102030405060708090a0b0c0d0e0f";
+const int    MAX_NODES = 4;
+const int    REORDER_WINDOW = 8;
+const int    REORDER_TIMEOUT = 30000;
+const int    RECEIVE_BATCH = 64;
+const int    HISTORY_SIZE = 144;
+
+struct History {                             // Stands in for the thermostat history store
+  float    Temp[HISTORY_SIZE];
+  uint8_t  Humi[HISTORY_SIZE];
+  uint32_t Count = 0;
+};
+
+History  _history[MAX_NODES];
+uint64_t _delivered = 0;
+
+static uint32_t nowMs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void addReadings(size_t slot, const SensorNodeStats &, const SensorReading *readings, size_t count) {
+  History &h = _history[slot];
+  for (size_t r = 0; r < count; r++, h.Count++) {
+    h.Temp[h.Count % HISTORY_SIZE] = readings[r].Temp;
+    h.Humi[h.Count % HISTORY_SIZE] = readings[r].Humi;
+  }
+  _delivered += count;
+}
+
+int main(int argc, char **argv) {
+  int port = argc > 1 ? atoi(argv[1]) : DEFAULT_PORT;
+  const char *hex = argc > 2 ? argv[2] : DEFAULT_KEY;
+  int seconds = argc > 3 ? atoi(argv[3]) : 0;
+  uint8_t key[16];
+  if (!parseSensorKey(hex, key)) {
+    fprintf(stderr, "Key must be 32 hex digits\n");
+    return 1;
+  }
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  int size = 4 << 20;
+  setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    perror("bind");
+    return 1;
+  }
+  struct timeval timeout = {0, 100000};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  static SensorIngest<MAX_NODES, REORDER_WINDOW> ingest;
+  ingest.begin(key, addReadings, REORDER_TIMEOUT);
+  printf("Listening on UDP port %d\n", port);
+
+  static uint8_t buffers[RECEIVE_BATCH][SENSOR_PACKET_MAX + 1];
+  struct iovec iov[RECEIVE_BATCH];
+  struct mmsghdr msgs[RECEIVE_BATCH] = {};
+  for (int i = 0; i < RECEIVE_BATCH; i++) {
+    iov[i].iov_base = buffers[i];
+    iov[i].iov_len = sizeof(buffers[i]);
+    msgs[i].msg_hdr.msg_iov = &iov[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  uint32_t start = nowMs(), lastReport = start;
+  uint64_t packets = 0, lastPackets = 0, lastDelivered = 0;
+  for (;;) {
+    int n = recvmmsg(fd, msgs, RECEIVE_BATCH, MSG_WAITFORONE, NULL);
+    uint32_t now = nowMs();
+    for (int i = 0; i < n; i++) ingest.receive(buffers[i], msgs[i].msg_len, now);
+    if (n > 0) packets += n;
+    ingest.expire(now);
+    if (now - lastReport >= 1000) {
+      double secs = (now - lastReport) / 1000.0;
+      printf("%.0f packets/s, %.0f readings/s", (packets - lastPackets) / secs, (_delivered - lastDelivered) / secs);
+      for (size_t s = 0; s < ingest.nodes(); s++) {
+        const SensorNodeStats &node = ingest.node(s);
+        printf(" | node %u: %u readings, %u lost, %u dup, %u reordered", node.Node, node.Readings, node.Lost, node.Duplicates, node.Reordered);
+      }
+      printf(" | %u bad tag, %u malformed\n", ingest.unauthenticated(), ingest.malformed());
+      fflush(stdout);
+      lastReport = now;
+      lastPackets = packets;
+      lastDelivered = _delivered;
+    }
+    if (seconds > 0 && now - start >= (uint32_t)seconds * 1000) break;
+  }
+  printf("Total %llu packets, %llu readings\n", (unsigned long long)packets, (unsigned long long)_delivered);
+  close(fd);
+  return 0;
+}
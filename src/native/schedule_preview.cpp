@@ -0,0 +1,157 @@
+// Linux schedule preview, runs a saved schedule through the thermostat's own control code and prints the same JSON as /simulate.
+// Settings come from a copy of the device's params.txt, with key=value overrides named as the /simulate arguments.
+//   .pio/build/native_sim/program params.txt [trace=temps.csv] [step=10] [days=7] [outside=5] [earlystart=30] ...
+// A trace file holds one temperature per line (the first field of a CSV line), replayed every 'step' minutes.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include "calendar.hpp"
+#include "simulate.hpp"
+
+const uint32_t DEFAULT_START = 1704585600;     // Sun 7 Jan 2024 00:00 UTC, so day 0 of the output is a Sunday
+const size_t   LINE_LENGTH   = 64;
+
+struct Timeline : public SimulationObserver {
+  void setpoint(uint32_t minute, float target, bool timerOn) override {
+    printf("%s[%u,%.1f,%d]", changes++ ? "," : "", (unsigned)minute, target, timerOn ? 1 : 0);
+  }
+  void hour(uint32_t, float meanTemp, uint32_t heatMinutes) override {      // Hours arrive in order
+    temps.push_back(meanTemp);
+    heat.push_back(heatMinutes);
+  }
+  uint32_t changes = 0;
+  std::vector<float> temps;
+  std::vector<uint32_t> heat;
+};
+
+static double nowSeconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Minimum ON/OFF times as the setup page limits them, a negative dwell would lock the relay
+static int dwellMinutes(const char *text) {
+  int minutes = atoi(text);
+  return minutes < 0 ? 0 : minutes > 99 ? 99 : minutes;
+}
+
+static bool readLine(FILE *file, char *line) {
+  if (!fgets(line, LINE_LENGTH, file)) return false;
+  line[strcspn(line, "\r\n")] = 0;
+  return true;
+}
+
+// Same layout as saveSettingsPage(): Temp, Start and Stop for each period of each day, then the scalar settings
+static bool readSettings(const char *path, WeeklySchedule &schedule, ControlSettings &settings) {
+  FILE *file = fopen(path, "r");
+  if (!file) return false;
+  char line[LINE_LENGTH];
+  bool ok = true;
+  for (int dow = 0; dow < 7 && ok; dow++) {
+    for (int p = 0; p < SCHEDULE_PERIODS && ok; p++) {
+      SchedulePeriod &period = schedule.Days[dow][p];
+      ok = readLine(file, line);
+      period.Temp = atof(line);
+      ok = ok && readLine(file, line);
+      period.Start = parseClock(line);
+      ok = ok && readLine(file, line);
+      period.Stop = parseClock(line);
+    }
+  }
+  if (ok && readLine(file, line)) settings.Hysteresis = atof(line);
+  if (ok && readLine(file, line)) settings.FrostTemp  = atof(line);
+  if (ok && readLine(file, line)) settings.EarlyStart = atoi(line);
+  if (ok && readLine(file, line)) settings.MinOnTime  = dwellMinutes(line);  // Absent in older files
+  if (ok && readLine(file, line)) settings.MinOffTime = dwellMinutes(line);
+  fclose(file);
+  return ok;
+}
+
+static bool readTrace(const char *path, std::vector<float> &temps) {
+  FILE *file = fopen(path, "r");
+  if (!file) return false;
+  char line[LINE_LENGTH];
+  while (readLine(file, line)) {
+    char *end;
+    float temp = strtof(line, &end);
+    if (end != line) temps.push_back(temp);   // Skips headers and blank lines
+  }
+  fclose(file);
+  return !temps.empty();
+}
+
+static bool is(const char *key, size_t length, const char *name) {
+  return strlen(name) == length && !strncmp(key, name, length);
+}
+
+int main(int argc, char **argv) {
+  WeeklySchedule schedule;
+  ControlSettings settings;
+  ControlState state;
+  ThermalModel model;
+  TemperatureTrace trace;
+  std::vector<float> temps;
+  uint32_t start = DEFAULT_START, days = 7;
+  int32_t utcOffset = 0;
+  float power = 2000;
+  if (argc < 2 || !readSettings(argv[1], schedule, settings)) {
+    fprintf(stderr, "Usage: %s params.txt [key=value ...], params.txt as saved by the thermostat\n", argv[0]);
+    return 1;
+  }
+  for (int i = 2; i < argc; i++) {
+    const char *value = strchr(argv[i], '=');
+    if (!value) {
+      fprintf(stderr, "Bad argument %s, expected key=value\n", argv[i]);
+      return 1;
+    }
+    size_t length = value++ - argv[i];
+    const char *key = argv[i];
+    if      (is(key, length, "trace")) {
+      if (!readTrace(value, temps)) {
+        fprintf(stderr, "No temperatures in %s\n", value);
+        return 1;
+      }
+    }
+    else if (is(key, length, "step"))               trace.Minutes            = atoi(value);
+    else if (is(key, length, "days"))               days                     = atoi(value);
+    else if (is(key, length, "start"))              start                    = strtoul(value, nullptr, 10);
+    else if (is(key, length, "utcoffset"))          utcOffset                = atoi(value);
+    else if (is(key, length, "power"))              power                    = atof(value);
+    else if (is(key, length, "hysteresis"))         settings.Hysteresis      = atof(value);
+    else if (is(key, length, "frosttemp"))          settings.FrostTemp       = atof(value);
+    else if (is(key, length, "earlystart"))         settings.EarlyStart      = atoi(value);
+    else if (is(key, length, "minontime"))          settings.MinOnTime       = dwellMinutes(value);
+    else if (is(key, length, "minofftime"))         settings.MinOffTime      = dwellMinutes(value);
+    else if (is(key, length, "manualoverride"))     state.ManualOverride     = !strcmp(value, "ON");
+    else if (is(key, length, "manualoverridetemp")) settings.ManOverrideTemp = atof(value);
+    else if (is(key, length, "starttemp"))          model.StartTemp          = atof(value);
+    else if (is(key, length, "outside"))            model.Outside            = atof(value);
+    else if (is(key, length, "loss"))               model.LossPerHour        = atof(value);
+    else if (is(key, length, "gain"))               model.GainPerHour        = atof(value);
+    else {
+      fprintf(stderr, "Unknown setting %s\n", argv[i]);
+      return 1;
+    }
+  }
+  if (!temps.empty()) {
+    trace.Temps = temps.data();
+    trace.Count = temps.size();
+  }
+  if (days < 1 || days > 7) days = 7;
+
+  Timeline timeline;
+  printf("{\"start\":%u,\"trace\":\"%s\",\"changes\":[", (unsigned)start, trace.Temps ? "history" : "model");
+  double began = nowSeconds();
+  SimulationResult result = simulateSchedule(schedule, settings, state, (const ExceptionCalendar<1> *)nullptr, start, utcOffset,
+                                             days * 24 * 60, trace, model, &timeline);
+  double elapsed = nowSeconds() - began;
+  printf("],\"hours\":[");
+  for (size_t h = 0; h < timeline.temps.size(); h++) printf("%s[%.1f,%u]", h ? "," : "", timeline.temps[h], (unsigned)timeline.heat[h]);
+  char summary[320];
+  formatSimulationSummary(result, power, summary, sizeof(summary));
+  printf("],\"changes_total\":%u,%s,\"elapsed_ms\":%.1f}\n", (unsigned)timeline.changes, summary, elapsed * 1000);
+  return 0;
+}
@@ -0,0 +1,81 @@
+// Linux test client for the remote sensor ingestion path, sends signed batched packets as fast as asked.
+// Optional loss and reordering exercise the deduplication and sequence ordering of the receiver.
+//   .pio/build/native_sensor/program [host] [port] [nodes] [packets/s] [batch] [seconds] [loss %] [reorder %] [key]
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "ingest.hpp"
+
+const char *DEFAULT_KEY = "000102030405060708090a0b0c0d0e0f";
+
+static double nowSeconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+  const char *host = argc > 1 ? argv[1] : "127.0.0.1";
+  int port = argc > 2 ? atoi(argv[2]) : 4210;
+  int nodes = argc > 3 ? atoi(argv[3]) : 4;
+  int rate = argc > 4 ? atoi(argv[4]) : 1000;
+  int batch = argc > 5 ? atoi(argv[5]) : 8;
+  int seconds = argc > 6 ? atoi(argv[6]) : 5;
+  int loss = argc > 7 ? atoi(argv[7]) : 0;
+  int reorder = argc > 8 ? atoi(argv[8]) : 0;
+  const char *hex = argc > 9 ? argv[9] : DEFAULT_KEY;
+  uint8_t key[16];
+  if (!parseSensorKey(hex, key) || nodes < 1 || nodes > 253 || batch < 1 || batch > (int)SENSOR_PACKET_BATCH || rate < 1) {
+    fprintf(stderr, "Bad arguments, batch is 1-%u readings and the key 32 hex digits\n", (unsigned)SENSOR_PACKET_BATCH);
+    return 1;
+  }
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  if (fd < 0 || inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+    fprintf(stderr, "Bad host %s\n", host);
+    return 1;
+  }
+
+  uint32_t boot = time(nullptr);               // Each run is a new boot of every node
+  uint32_t seq[254] = {0};
+  static uint8_t held[254][SENSOR_PACKET_MAX]; // Per node, a packet held back to send after the node's next one
+  size_t heldLength[254] = {0};
+  uint64_t sent = 0, readings = 0;
+  SensorReading batchReadings[SENSOR_PACKET_BATCH];
+  uint8_t packet[SENSOR_PACKET_MAX];
+  double start = nowSeconds(), interval = 1.0 / rate;
+  for (uint64_t i = 0; nowSeconds() - start < seconds; i++) {
+    while (nowSeconds() < start + i * interval) {}   // Busy wait, sleeping is too coarse at high rates
+    uint8_t node = 1 + i % nodes;
+    for (int r = 0; r < batch; r++) {
+      batchReadings[r].Temp = 18 + (rand() % 600) / 100.0f;
+      batchReadings[r].Humi = 40 + rand() % 20;
+      batchReadings[r].Battery = 100 - (seq[node] / 1000) % 100;
+    }
+    size_t length = encodeSensorPacket(key, node, boot, seq[node]++, batchReadings, batch, packet);
+    readings += batch;
+    if (rand() % 100 < loss) continue;
+    if (heldLength[node] == 0 && rand() % 100 < reorder) {
+      memcpy(held[node], packet, length);
+      heldLength[node] = length;
+      continue;
+    }
+    sendto(fd, packet, length, 0, (struct sockaddr *)&addr, sizeof(addr));
+    sent++;
+    if (heldLength[node]) {
+      sendto(fd, held[node], heldLength[node], 0, (struct sockaddr *)&addr, sizeof(addr));
+      heldLength[node] = 0;
+      sent++;
+    }
+  }
+  double elapsed = nowSeconds() - start;
+  printf("Sent %llu packets, %llu readings generated, %.0f readings/s\n", (unsigned long long)sent, (unsigned long long)readings, readings / elapsed);
+  close(fd);
+  return 0;
+}
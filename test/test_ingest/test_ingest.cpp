@@ -0,0 +1,102 @@
+// Remote sensor ingestion: ordering, loss and replay handling, run natively with 'make test-native'
+#include <unity.h>
+#include <vector>
+#include "ingest.hpp"
+
+static const uint8_t KEY[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+static const uint8_t NODE = 7;
+
+static SensorIngest<2, 8> ingest;
+static std::vector<float> delivered;          // Temperature of each reading handed on, which is its sequence number
+
+static void collect(size_t, const SensorNodeStats &, const SensorReading *readings, size_t count) {
+  for (size_t r = 0; r < count; r++) delivered.push_back(readings[r].Temp);
+}
+
+static IngestResult send(uint32_t boot, uint32_t seq, uint32_t nowMs = 0) {
+  SensorReading reading;
+  reading.Temp = seq;
+  uint8_t packet[SENSOR_PACKET_MAX];
+  size_t length = encodeSensorPacket(KEY, NODE, boot, seq, &reading, 1, packet);
+  return ingest.receive(packet, length, nowMs);
+}
+
+void setUp() {
+  ingest = SensorIngest<2, 8>();
+  ingest.begin(KEY, collect, 1000);
+  delivered.clear();
+}
+
+void tearDown() {}
+
+void test_in_order_packets_are_delivered() {
+  for (uint32_t seq = 0; seq < 20; seq++) TEST_ASSERT_EQUAL(INGEST_ACCEPTED, send(1, seq));
+  TEST_ASSERT_EQUAL(20, delivered.size());
+  TEST_ASSERT_EQUAL_FLOAT(19, delivered.back());
+  TEST_ASSERT_EQUAL_UINT32(0, ingest.node(0).Lost);
+  TEST_ASSERT_EQUAL_UINT32(0, ingest.node(0).Reordered);
+}
+
+void test_replayed_old_packet_is_rejected() {
+  for (uint32_t seq = 0; seq < 100; seq++) send(1, seq);
+  TEST_ASSERT_EQUAL(INGEST_DUPLICATE, send(1, 5));           // Captured earlier, far behind the window
+  TEST_ASSERT_EQUAL(100, delivered.size());
+  TEST_ASSERT_EQUAL(INGEST_ACCEPTED, send(1, 100));          // The genuine stream carries on undisturbed
+  TEST_ASSERT_EQUAL(101, delivered.size());
+  TEST_ASSERT_EQUAL_FLOAT(100, delivered.back());
+  TEST_ASSERT_EQUAL_UINT32(0, ingest.node(0).Lost);
+  TEST_ASSERT_EQUAL_UINT32(0, ingest.node(0).Restarts);
+}
+
+void test_new_boot_restarts_and_old_boot_is_replay() {
+  for (uint32_t seq = 0; seq < 50; seq++) send(1, seq);
+  TEST_ASSERT_EQUAL(INGEST_ACCEPTED, send(2, 0));            // Node reset
+  TEST_ASSERT_EQUAL_UINT32(1, ingest.node(0).Restarts);
+  TEST_ASSERT_EQUAL(51, delivered.size());
+  TEST_ASSERT_EQUAL(INGEST_DUPLICATE, send(1, 50));          // Ahead in sequence, but from the previous boot
+  TEST_ASSERT_EQUAL(INGEST_ACCEPTED, send(2, 1));
+  TEST_ASSERT_EQUAL(52, delivered.size());
+  TEST_ASSERT_EQUAL_UINT32(0, ingest.node(0).Lost);
+}
+
+void test_late_packet_fills_gap_and_counts_as_reordered() {
+  send(1, 0);
+  send(1, 2);
+  TEST_ASSERT_EQUAL(1, delivered.size());                    // Held waiting for 1
+  TEST_ASSERT_EQUAL(INGEST_ACCEPTED, send(1, 1));
+  TEST_ASSERT_EQUAL(3, delivered.size());
+  TEST_ASSERT_EQUAL_FLOAT(1, delivered[1]);
+  TEST_ASSERT_EQUAL_UINT32(1, ingest.node(0).Reordered);
+  TEST_ASSERT_EQUAL_UINT32(0, ingest.node(0).Lost);
+}
+
+void test_lost_packet_is_not_counted_as_reordered() {
+  send(1, 0, 0);
+  send(1, 2, 0);
+  send(1, 3, 0);
+  ingest.expire(1000);                                       // Give up on 1
+  TEST_ASSERT_EQUAL(3, delivered.size());
+  TEST_ASSERT_EQUAL_UINT32(1, ingest.node(0).Lost);
+  TEST_ASSERT_EQUAL_UINT32(0, ingest.node(0).Reordered);
+  TEST_ASSERT_EQUAL(INGEST_DUPLICATE, send(1, 1, 1000));     // Too late once given up on
+}
+
+void test_tampered_packet_is_unauthenticated() {
+  SensorReading reading;
+  uint8_t packet[SENSOR_PACKET_MAX];
+  size_t length = encodeSensorPacket(KEY, NODE, 1, 0, &reading, 1, packet);
+  packet[SENSOR_PACKET_HEADER] ^= 1;
+  TEST_ASSERT_EQUAL(INGEST_UNAUTHENTICATED, ingest.receive(packet, length, 0));
+  TEST_ASSERT_EQUAL(0, ingest.nodes());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_in_order_packets_are_delivered);
+  RUN_TEST(test_replayed_old_packet_is_rejected);
+  RUN_TEST(test_new_boot_restarts_and_old_boot_is_replay);
+  RUN_TEST(test_late_packet_fills_gap_and_counts_as_reordered);
+  RUN_TEST(test_lost_packet_is_not_counted_as_reordered);
+  RUN_TEST(test_tampered_packet_is_unauthenticated);
+  return UNITY_END();
+}
@@ -0,0 +1,155 @@
+// Schedule resolution and control decisions, run natively with 'make test-native'
+#include <unity.h>
+#include "simulate.hpp"
+
+static const uint32_t SUNDAY = 1704585600;    // Sun 7 Jan 2024 00:00 UTC
+
+static WeeklySchedule schedule;
+static ControlSettings settings;
+static ControlState state;
+
+static void setPeriod(int day, int p, int start, int stop, float temp) {
+  schedule.Days[day][p].Start = start;
+  schedule.Days[day][p].Stop = stop;
+  schedule.Days[day][p].Temp = temp;
+}
+
+static CalendarException exception(uint8_t kind, float value) {
+  CalendarException e;
+  e.Start = SUNDAY;
+  e.Stop = SUNDAY + 7 * 86400;
+  e.Kind = kind;
+  e.Value = value;
+  return e;
+}
+
+static bool timerOn(int day, int minute, const CalendarException *now = nullptr, const CalendarException *upcoming = nullptr) {
+  return evaluateControl(schedule, settings, state, day, minute, now, upcoming, 15).TimerOn;
+}
+
+void setUp() {
+  schedule = WeeklySchedule();
+  settings = ControlSettings();
+  state = ControlState();
+}
+
+void tearDown() {}
+
+void test_over_temperature_forces_off_outside_the_timer() {
+  ControlResult result = evaluateControl(schedule, settings, state, 0, 12 * 60, nullptr, nullptr, 30);
+  TEST_ASSERT_FALSE(result.TimerOn);
+  TEST_ASSERT_EQUAL(DEMAND_OFF, result.Demand);
+  TEST_ASSERT_TRUE(result.Force);
+}
+
+void test_over_temperature_forces_off_during_a_period() {
+  setPeriod(0, 0, 6 * 60, 22 * 60, 35);        // Set-point above the limit
+  ControlResult result = evaluateControl(schedule, settings, state, 0, 12 * 60, nullptr, nullptr, 29);
+  TEST_ASSERT_TRUE(result.TimerOn);
+  TEST_ASSERT_EQUAL(DEMAND_OFF, result.Demand);
+  TEST_ASSERT_TRUE(result.Force);
+}
+
+void test_minimum_on_time_does_not_hold_heat_above_the_limit() {
+  for (int day = 0; day < 7; day++) setPeriod(day, 0, 6 * 60, 22 * 60 + 30, 22);
+  settings.MinOnTime = 99;
+  ThermalModel model;
+  model.GainPerHour = 12;
+  TemperatureTrace trace;
+  SimulationResult result = simulateSchedule(schedule, settings, state, (const ExceptionCalendar<1> *)nullptr, SUNDAY, 0,
+                                             SIMULATION_WEEK, trace, model, nullptr);
+  TEST_ASSERT_TRUE(result.TempMax < settings.MaxTemperature + 0.5f); // One minute of heating past the limit at most
+}
+
+void test_early_start_keeps_the_period_on_until_its_stop() {
+  setPeriod(1, 0, 6 * 60, 9 * 60, 21);
+  settings.EarlyStart = 30;
+  TEST_ASSERT_FALSE(timerOn(1, 5 * 60 + 29));
+  TEST_ASSERT_TRUE(timerOn(1, 5 * 60 + 30));
+  TEST_ASSERT_TRUE(timerOn(1, 8 * 60 + 59));
+  TEST_ASSERT_TRUE(timerOn(1, 9 * 60));
+  TEST_ASSERT_FALSE(timerOn(1, 9 * 60 + 1));
+}
+
+void test_early_start_reaches_into_the_next_day() {
+  setPeriod(1, 0, 0, 2 * 60, 22);              // Monday from midnight
+  settings.EarlyStart = 30;
+  TEST_ASSERT_FALSE(timerOn(0, 23 * 60 + 29));
+  TEST_ASSERT_TRUE(timerOn(0, 23 * 60 + 45));
+  TEST_ASSERT_EQUAL_FLOAT(22, state.TargetTemp);
+  TEST_ASSERT_FALSE(timerOn(6, 23 * 60 + 45)); // Saturday evening, Sunday has no period
+}
+
+void test_early_start_follows_the_calendar_for_the_next_day() {
+  setPeriod(1, 0, 0, 2 * 60, 22);
+  settings.EarlyStart = 30;
+  CalendarException away = exception(EXCEPTION_AWAY, 0);
+  CalendarException holiday = exception(EXCEPTION_HOLIDAY, 6); // Monday follows Saturday, which has no period
+  CalendarException setpoint = exception(EXCEPTION_SETPOINT, 23);
+  TEST_ASSERT_FALSE(timerOn(0, 23 * 60 + 45, nullptr, &away));
+  TEST_ASSERT_FALSE(timerOn(0, 23 * 60 + 45, nullptr, &holiday));
+  TEST_ASSERT_FALSE(timerOn(0, 23 * 60 + 45, nullptr, &setpoint));
+  setPeriod(2, 0, 0, 2 * 60, 19);
+  CalendarException tuesday = exception(EXCEPTION_HOLIDAY, 2);
+  TEST_ASSERT_TRUE(timerOn(0, 23 * 60 + 45, nullptr, &tuesday));
+  TEST_ASSERT_EQUAL_FLOAT(19, state.TargetTemp);
+}
+
+void test_no_demand_while_the_clock_is_unset() {
+  for (int day = 0; day < 7; day++) setPeriod(day, 0, 0, 23 * 60 + 59, 21);
+  CalendarException setpoint = exception(EXCEPTION_SETPOINT, 23);
+  ControlResult result = evaluateControl(schedule, settings, state, -1, 0, &setpoint, &setpoint, 15);
+  TEST_ASSERT_FALSE(result.TimerOn);
+  TEST_ASSERT_EQUAL(DEMAND_OFF, result.Demand);
+  result = evaluateControl(schedule, settings, state, -1, 0, nullptr, nullptr, 3); // Frost protection still applies
+  TEST_ASSERT_EQUAL(DEMAND_ON, result.Demand);
+  TEST_ASSERT_TRUE(result.Frost);
+}
+
+void test_calendar_overrides_the_schedule() {
+  setPeriod(0, 0, 6 * 60, 22 * 60, 21);
+  setPeriod(6, 0, 10 * 60, 12 * 60, 18);
+  CalendarException setpoint = exception(EXCEPTION_SETPOINT, 23);
+  ControlResult result = evaluateControl(schedule, settings, state, 0, 3 * 60, &setpoint, &setpoint, 22);
+  TEST_ASSERT_TRUE(result.TimerOn);
+  TEST_ASSERT_EQUAL_FLOAT(23, state.TargetTemp);
+  TEST_ASSERT_EQUAL(DEMAND_ON, result.Demand);
+  CalendarException away = exception(EXCEPTION_AWAY, 0);
+  result = evaluateControl(schedule, settings, state, 0, 12 * 60, &away, &away, 15);
+  TEST_ASSERT_FALSE(result.TimerOn);
+  TEST_ASSERT_EQUAL_FLOAT(settings.FrostTemp, state.TargetTemp);
+  TEST_ASSERT_EQUAL(DEMAND_OFF, result.Demand);
+  CalendarException holiday = exception(EXCEPTION_HOLIDAY, 6);   // Sunday follows Saturday's profile
+  TEST_ASSERT_FALSE(timerOn(0, 7 * 60, &holiday, &holiday));
+  TEST_ASSERT_TRUE(timerOn(0, 11 * 60, &holiday, &holiday));
+  TEST_ASSERT_EQUAL_FLOAT(18, state.TargetTemp);
+}
+
+void test_simulated_calendar_suppresses_early_start() {
+  setPeriod(1, 0, 0, 2 * 60, 22);
+  settings.EarlyStart = 30;
+  ExceptionCalendar<1> calendar;
+  CalendarException away = exception(EXCEPTION_AWAY, 0);
+  away.Start = SUNDAY + 86400;                 // Away from Monday midnight
+  calendar.add(away);
+  TemperatureTrace trace;
+  SimulationResult result = simulateSchedule(schedule, settings, state, &calendar, SUNDAY, 0, 86400 / 60, trace, ThermalModel(), nullptr);
+  TEST_ASSERT_EQUAL_UINT32(0, result.TimerMinutes);
+  result = simulateSchedule(schedule, settings, state, (const ExceptionCalendar<1> *)nullptr, SUNDAY, 0, 86400 / 60, trace,
+                            ThermalModel(), nullptr);
+  TEST_ASSERT_EQUAL_UINT32(30, result.TimerMinutes);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_over_temperature_forces_off_outside_the_timer);
+  RUN_TEST(test_over_temperature_forces_off_during_a_period);
+  RUN_TEST(test_minimum_on_time_does_not_hold_heat_above_the_limit);
+  RUN_TEST(test_early_start_keeps_the_period_on_until_its_stop);
+  RUN_TEST(test_early_start_reaches_into_the_next_day);
+  RUN_TEST(test_early_start_follows_the_calendar_for_the_next_day);
+  RUN_TEST(test_no_demand_while_the_clock_is_unset);
+  RUN_TEST(test_calendar_overrides_the_schedule);
+  RUN_TEST(test_simulated_calendar_suppresses_early_start);
+  return UNITY_END();
+}